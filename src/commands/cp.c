@@ -75,38 +75,12 @@ void cmd_cp(const char* args) {
             return;
         }
         
-        // Open source file
-        fs_file_handle_t* src_file = fs_open(src_filename, "r");
-        if (!src_file) {
-            terminal_writestring("Error: Could not open source file\n");
+        // Copied inside the filesystem, whole cluster runs at a time
+        if (!fs_copy(src_filename, dst_filename)) {
+            terminal_writestring("Error: Copy failed\n");
             return;
         }
-        
-        // Create destination file
-        fs_file_handle_t* dst_file = fs_open(dst_filename, "w");
-        if (!dst_file) {
-            terminal_writestring("Error: Could not create destination file\n");
-            fs_close(src_file);
-            return;
-        }
-        
-        // Copy data
-        char buffer[512];
-        size_t bytes_read;
-        size_t total_copied = 0;
-        
-        while ((bytes_read = fs_read(src_file, buffer, sizeof(buffer))) > 0) {
-            size_t bytes_written = fs_write(dst_file, buffer, bytes_read);
-            total_copied += bytes_written;
-            
-            if (bytes_written != bytes_read) {
-                terminal_writestring("Error: Write failed during copy\n");
-                break;
-            }
-        }
-        
-        fs_close(src_file);
-        fs_close(dst_file);
+        size_t total_copied = fs_get_file_size(dst_filename);
         
         terminal_writestring("Copied ");
         // Simple number to string conversion
@@ -4,24 +4,6 @@
 
 extern void terminal_writestring(const char* data);
 
-// Helper function to find substring manually
-static const char* find_redirect(const char* str, const char* pattern) {
-    if (!str || !pattern) return NULL;
-    
-    size_t pattern_len = strlen(pattern);
-    size_t str_len = strlen(str);
-    
-    if (pattern_len > str_len) return NULL;
-    
-    for (size_t i = 0; i <= str_len - pattern_len; i++) {
-        if (strncmp(str + i, pattern, pattern_len) == 0) {
-            return str + i;
-        }
-    }
-    
-    return NULL;
-}
-
 void cmd_echo(const char* args) {
     if (!args || !*args) {
         terminal_writestring("\n");
@@ -32,8 +14,8 @@ void cmd_echo(const char* args) {
     while (*args == ' ') args++;
     
     // Check for output redirection
-    const char* redirect_pos = find_redirect(args, " > ");
-    const char* append_pos = find_redirect(args, " >> ");
+    const char* redirect_pos = strstr(args, " > ");
+    const char* append_pos = strstr(args, " >> ");
     
     if (append_pos) {
         // Append to file
@@ -73,8 +55,11 @@ void cmd_echo(const char* args) {
                 return;
             }
             
-            fs_write(file, content, strlen(content));
-            fs_write(file, "\n", 1);
+            fs_const_iovec_t line[2] = {
+                { content, strlen(content) },
+                { "\n", 1 },
+            };
+            fs_writev(file, line, 2);
             fs_close(file);
             
             terminal_writestring("Content appended to '");
@@ -121,8 +106,11 @@ void cmd_echo(const char* args) {
                 return;
             }
             
-            fs_write(file, content, strlen(content));
-            fs_write(file, "\n", 1);
+            fs_const_iovec_t line[2] = {
+                { content, strlen(content) },
+                { "\n", 1 },
+            };
+            fs_writev(file, line, 2);
             fs_close(file);
             
             terminal_writestring("Content written to '");
@@ -24,7 +24,7 @@ void cmd_help(const char* args) {
         terminal_writestring("  echo <text>         - Display text\n");
         terminal_writestring("  echo <text> > <file> - Write text to file\n");
         terminal_writestring("  echo <text> >> <file> - Append text to file\n");
-        terminal_writestring("  system [info]       - Show system information\n");
+        terminal_writestring("  system [info|heap]  - Show system information\n");
         terminal_writestring("  mount               - Mount FAT32 filesystem\n");
         terminal_writestring("  unmount             - Unmount filesystem\n");
         terminal_writestring("  fsinfo              - Show filesystem information\n\n");
@@ -33,6 +33,9 @@ extern size_t terminal_column;
 // Editor constants
 #define EDITOR_MAX_LINES 1000
 #define EDITOR_MAX_COLS 256
+#define EDITOR_SAVE_BATCH 32    // Lines per fs_writev call when saving
+#define EDITOR_SAVE_TEMP "PIASAVE.TMP" // Written first, renamed over the file
+#define EDITOR_SAVE_TEMP_ALT "PIASAVE2.TMP" // Used when editing EDITOR_SAVE_TEMP itself
 
 // Editor state
 typedef struct {
@@ -155,13 +158,91 @@ void editor_save_file(void) {
         return;
     }
     
-    // Note: File writing is not fully implemented in FAT32 yet
-    terminal_writestring("Error: File writing not yet implemented in FAT32\n");
-    terminal_writestring("File would be saved as: ");
-    terminal_writestring(editor_state.filename);
-    terminal_writestring("\n");
+    // Write a temporary file next to the real one, and only replace the
+    // real one once the new contents are safely on disk
+    char temp[sizeof(editor_state.filename)];
+    const char* slash = strrchr(editor_state.filename, '/');
+    size_t dir_len = slash ? (size_t)(slash - editor_state.filename) + 1 : 0;
+    if (dir_len + sizeof(EDITOR_SAVE_TEMP_ALT) > sizeof(temp)) {
+        terminal_writestring("Error: Filename too long\n");
+        return;
+    }
+    
+    // The temporary name must never be the file being saved
+    const char* base = editor_state.filename + dir_len;
+    const char* temp_name = EDITOR_SAVE_TEMP;
+    for (size_t i = 0; i < sizeof(EDITOR_SAVE_TEMP); i++) {
+        char c = (base[i] >= 'a' && base[i] <= 'z') ? base[i] - 32 : base[i];
+        if (c != EDITOR_SAVE_TEMP[i]) {
+            break;
+        }
+        if (c == '\0') {
+            temp_name = EDITOR_SAVE_TEMP_ALT;
+        }
+    }
+    memcpy(temp, editor_state.filename, dir_len);
+    strcpy(temp + dir_len, temp_name);
+    
+    // A leftover from an earlier failed save; opening for write would keep
+    // its old contents
+    if (fs_exists(temp) && !fs_delete(temp)) {
+        terminal_writestring("Error: Failed to create file\n");
+        return;
+    }
+    
+    fs_file_handle_t* file = fs_open(temp, "w");
+    if (!file) {
+        terminal_writestring("Error: Failed to create file\n");
+        return;
+    }
+    
+    // Hand the lines over in batches, each followed by its newline except
+    // the last, so a saved file loads back unchanged
+    fs_const_iovec_t pieces[EDITOR_SAVE_BATCH * 2];
+    size_t expected = 0;
+    size_t written = 0;
+    int count = 0;
+    
+    for (int line = 0; line < editor_state.lines; line++) {
+        pieces[count].base = editor_state.buffer[line];
+        pieces[count].length = strlen(editor_state.buffer[line]);
+        expected += pieces[count].length;
+        count++;
+        
+        if (line + 1 < editor_state.lines) {
+            pieces[count].base = "\n";
+            pieces[count].length = 1;
+            expected++;
+            count++;
+        }
+        
+        if (count >= EDITOR_SAVE_BATCH * 2 - 1 || line + 1 == editor_state.lines) {
+            written += fs_writev(file, pieces, count);
+            count = 0;
+        }
+    }
     
-    // TODO: Implement this when fs_write is fully available
+    bool ok = fs_flush(file) && written == expected;
+    fs_close(file);
+    if (!ok) {
+        fs_delete(temp);
+        terminal_writestring("Error: Failed to write file\n");
+        return;
+    }
+    
+    if (fs_exists(editor_state.filename) && !fs_delete(editor_state.filename)) {
+        fs_delete(temp);
+        terminal_writestring("Error: Failed to replace file\n");
+        return;
+    }
+    if (!fs_rename(temp, editor_state.filename)) {
+        terminal_writestring("Error: Saved as ");
+        terminal_writestring(temp);
+        terminal_writestring("\n");
+        return;
+    }
+    
+    editor_state.modified = false;
 }
 
 char editor_get_key(void) {
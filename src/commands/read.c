@@ -4,6 +4,7 @@
 #include <stdint.h>
 
 extern void terminal_writestring(const char* data);
+extern void terminal_write(const char* data, size_t size);
 extern void terminal_setcolor(uint8_t color);
 extern uint8_t terminal_getcolor(void);
 
@@ -25,15 +26,10 @@ int is_image_file(const char* filename) {
     return 0;
 }
 
-// Simple ASCII art renderer for image files
-void render_image_ascii(const char* content) {
-    terminal_writestring("ASCII Image Rendering:\n\n");
-    
-    uint8_t original_color = terminal_getcolor();
-    
-    // Process the image data
-    const char* ptr = content;
-    while (*ptr) {
+// Draw hex digits as coloured blocks
+static void render_image_pixels(const char* ptr, size_t length) {
+    const char* end = ptr + length;
+    while (ptr < end) {
         if ((*ptr >= '0' && *ptr <= '9') || (*ptr >= 'A' && *ptr <= 'F')) {
             // Convert hex character to a value (0-15)
             int value;
@@ -53,9 +49,26 @@ void render_image_ascii(const char* content) {
         }
         ptr++;
     }
+}
+
+// Simple ASCII art renderer for image files, drawing from the file in place.
+// Returns false if the file could not be read to the end.
+bool render_image_ascii(fs_file_handle_t* handle) {
+    terminal_writestring("ASCII Image Rendering:\n\n");
+    
+    uint8_t original_color = terminal_getcolor();
+    
+    const char* data;
+    uint32_t offset = 0;
+    uint32_t mapped;
+    while ((data = (const char*)fs_map(handle, offset, handle->file_size - offset, &mapped)) != NULL) {
+        render_image_pixels(data, mapped);
+        offset += mapped;
+    }
     
     // Restore original color
-        terminal_setcolor(original_color);
+    terminal_setcolor(original_color);
+    return offset >= handle->file_size;
 }
 
 void cmd_read(const char* args) {
@@ -91,39 +104,33 @@ void cmd_read(const char* args) {
         return;
     }
     
-    // Read file content
-    char buffer[1024];
-    size_t total_read = 0;
-    size_t bytes_read;
-    
     terminal_writestring("--- File: ");
     terminal_writestring(args);
     terminal_writestring(" ---\n");
     
     // Check if it's an image file
+    bool complete;
     if (is_image_file(args)) {
         terminal_writestring("Detected image file. Rendering...\n");
-        
-        // Read entire file for image rendering
-        char image_buffer[4096] = {0};
-        size_t image_pos = 0;
-        
-        while ((bytes_read = fs_read(handle, buffer, sizeof(buffer))) > 0 && 
-               image_pos < sizeof(image_buffer) - 1) {
-            for (size_t i = 0; i < bytes_read && image_pos < sizeof(image_buffer) - 1; i++) {
-                image_buffer[image_pos++] = buffer[i];
-            }
-        }
-        image_buffer[image_pos] = '\0';
-        
-        render_image_ascii(image_buffer);
+        complete = render_image_ascii(handle);
     } else {
-        // Regular text file - read and display in chunks
-        while ((bytes_read = fs_read(handle, buffer, sizeof(buffer) - 1)) > 0) {
-            buffer[bytes_read] = '\0';
-            terminal_writestring(buffer);
-            total_read += bytes_read;
+        // Regular text file - display it straight from the mapping
+        const char* data;
+        uint32_t offset = 0;
+        uint32_t mapped;
+        while ((data = (const char*)fs_map(handle, offset, handle->file_size - offset, &mapped)) != NULL) {
+            terminal_write(data, mapped);
+            offset += mapped;
         }
+        complete = offset >= handle->file_size;
+    }
+    
+    if (!complete) {
+        terminal_writestring("\nError: Failed to read ");
+        terminal_writestring(args);
+        terminal_writestring("\n");
+        fs_close(handle);
+        return;
     }
     
     terminal_writestring("\n--- End of file ---\n");
@@ -5,59 +5,16 @@
 #include "../include/io.h"
 #include "../include/disk.h"
 #include "../include/gpu.h"
+#include "../include/multiboot.h"
+#include "../include/pmm.h"
+#include "../include/memory.h"
+#include "../include/slab.h"
+#include "../include/cpu.h"
 
 // External function declarations
 extern void terminal_writestring(const char* data);
 extern size_t strlen(const char* str);
 
-// Multiboot definitions
-#define MULTIBOOT_FLAG_MEM     0x001
-#define MULTIBOOT_FLAG_DEVICE  0x002
-#define MULTIBOOT_FLAG_CMDLINE 0x004
-#define MULTIBOOT_FLAG_MODS    0x008
-#define MULTIBOOT_FLAG_AOUT    0x010
-#define MULTIBOOT_FLAG_ELF     0x020
-#define MULTIBOOT_FLAG_MMAP    0x040
-#define MULTIBOOT_FLAG_DRIVES  0x080
-#define MULTIBOOT_FLAG_CONFIG  0x100
-#define MULTIBOOT_FLAG_LOADER  0x200
-#define MULTIBOOT_FLAG_APM     0x400
-#define MULTIBOOT_FLAG_VBE     0x800
-
-typedef struct {
-    uint32_t flags;
-    uint32_t mem_lower;
-    uint32_t mem_upper;
-    uint32_t boot_device;
-    uint32_t cmdline;
-    uint32_t mods_count;
-    uint32_t mods_addr;
-    uint32_t syms[4];
-    uint32_t mmap_length;
-    uint32_t mmap_addr;
-    uint32_t drives_length;
-    uint32_t drives_addr;
-    uint32_t config_table;
-    uint32_t boot_loader_name;
-    uint32_t apm_table;
-    uint32_t vbe_control_info;
-    uint32_t vbe_mode_info;
-    uint16_t vbe_mode;
-    uint16_t vbe_interface_seg;
-    uint16_t vbe_interface_off;
-    uint16_t vbe_interface_len;
-} multiboot_info_t;
-
-typedef struct {
-    uint32_t size;
-    uint64_t addr;
-    uint64_t len;
-    uint32_t type;
-} multiboot_memory_map_t;
-
-// Define multiboot_info variable (will be initialized in kernel.c)
-extern multiboot_info_t* multiboot_info;
-
 // CPU information structure
 typedef struct {
     char vendor[13];
@@ -132,39 +89,9 @@ static void system_shutdown(void) {
     asm volatile("cli; hlt");
 }
 
-// Check if CPUID is supported
-static int cpuid_supported(void) {
-    uint32_t eflags_before, eflags_after;
-    
-    // Try to flip the ID bit (bit 21) in EFLAGS
-    asm volatile(
-        "pushfl\n\t"
-        "popl %0\n\t"
-        "movl %0, %1\n\t"
-        "xorl $0x200000, %0\n\t"
-        "pushl %0\n\t"
-        "popfl\n\t"
-        "pushfl\n\t"
-        "popl %0\n\t"
-        "pushl %1\n\t"
-        "popfl"
-        : "=&r" (eflags_after), "=&r" (eflags_before)
-        :
-        : "cc"
-    );
-    
-    return ((eflags_before ^ eflags_after) & 0x200000) != 0;
-}
-
-static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
-    asm volatile("cpuid"
-                : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
-                : "a" (leaf), "c" (subleaf));
-}
-
 static void get_cpu_vendor(cpu_info_t* cpu) {
     uint32_t eax, ebx, ecx, edx;
-    cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+    cpu_cpuid(0, 0, &eax, &ebx, &ecx, &edx);
     
     cpu->max_cpuid = eax;
     
@@ -179,7 +106,7 @@ static void get_cpu_brand(cpu_info_t* cpu) {
     uint32_t eax, ebx, ecx, edx;
     
     // Check if extended CPUID is supported
-    cpuid(0x80000000, 0, &eax, &ebx, &ecx, &edx);
+    cpu_cpuid(0x80000000, 0, &eax, &ebx, &ecx, &edx);
     cpu->max_extended_cpuid = eax;
     
     if (eax < 0x80000004) {
@@ -189,19 +116,19 @@ static void get_cpu_brand(cpu_info_t* cpu) {
     }
     
     // Get brand string from leaves 0x80000002, 0x80000003, 0x80000004
-    cpuid(0x80000002, 0, &eax, &ebx, &ecx, &edx);
+    cpu_cpuid(0x80000002, 0, &eax, &ebx, &ecx, &edx);
     *((uint32_t*)(cpu->brand + 0)) = eax;
     *((uint32_t*)(cpu->brand + 4)) = ebx;
     *((uint32_t*)(cpu->brand + 8)) = ecx;
     *((uint32_t*)(cpu->brand + 12)) = edx;
     
-    cpuid(0x80000003, 0, &eax, &ebx, &ecx, &edx);
+    cpu_cpuid(0x80000003, 0, &eax, &ebx, &ecx, &edx);
     *((uint32_t*)(cpu->brand + 16)) = eax;
     *((uint32_t*)(cpu->brand + 20)) = ebx;
     *((uint32_t*)(cpu->brand + 24)) = ecx;
     *((uint32_t*)(cpu->brand + 28)) = edx;
     
-    cpuid(0x80000004, 0, &eax, &ebx, &ecx, &edx);
+    cpu_cpuid(0x80000004, 0, &eax, &ebx, &ecx, &edx);
     *((uint32_t*)(cpu->brand + 32)) = eax;
     *((uint32_t*)(cpu->brand + 36)) = ebx;
     *((uint32_t*)(cpu->brand + 40)) = ecx;
@@ -216,7 +143,7 @@ static void get_cpu_signature(cpu_info_t* cpu) {
     
     if (cpu->max_cpuid < 1) return;
     
-    cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+    cpu_cpuid(1, 0, &eax, &ebx, &ecx, &edx);
     
     cpu->features_edx = edx;
     cpu->features_ecx = ecx;
@@ -244,7 +171,7 @@ static void get_extended_features(cpu_info_t* cpu) {
     uint32_t eax, ebx, ecx, edx;
     
     if (cpu->max_extended_cpuid >= 0x80000001) {
-        cpuid(0x80000001, 0, &eax, &ebx, &ecx, &edx);
+        cpu_cpuid(0x80000001, 0, &eax, &ebx, &ecx, &edx);
         cpu->extended_features_edx = edx;
         cpu->extended_features_ecx = ecx;
     } else {
@@ -256,7 +183,7 @@ static void get_extended_features(cpu_info_t* cpu) {
 // Get cache information
 static void get_cache_info(cpu_info_t* cpu) {
     if (cpu->max_cpuid >= 2) {
-        cpuid(2, 0, &cpu->cache_info[0], &cpu->cache_info[1], 
+        cpu_cpuid(2, 0, &cpu->cache_info[0], &cpu->cache_info[1], 
               &cpu->cache_info[2], &cpu->cache_info[3]);
     } else {
         cpu->cache_info[0] = cpu->cache_info[1] = 
@@ -329,7 +256,7 @@ static void system_info_cpu(void) {
     terminal_writestring("CPU Information:\n");
     
     // Check if CPUID is supported
-    if (!cpuid_supported()) {
+    if (!cpu_has_cpuid()) {
         terminal_writestring("  CPUID instruction not supported on this processor\n");
         terminal_writestring("  This appears to be a very old CPU (pre-486)\n");
         return;
@@ -619,6 +546,106 @@ static void system_info_memory(void) {
             mmap = (multiboot_memory_map_t*)((uint32_t)mmap + mmap->size + sizeof(mmap->size));
         }
     }
+
+    // Physical frame allocator state
+    if (pmm_is_initialized()) {
+        char buffer[32];
+
+        terminal_writestring("  Physical frames: ");
+        itoa(pmm_get_free_frames(), buffer, 10);
+        terminal_writestring(buffer);
+        terminal_writestring(" free / ");
+        itoa(pmm_get_total_frames(), buffer, 10);
+        terminal_writestring(buffer);
+        terminal_writestring(" usable (");
+        itoa(pmm_get_free_frames() / 256, buffer, 10);
+        terminal_writestring(buffer);
+        terminal_writestring(" MB free)\n");
+    } else {
+        terminal_writestring("  Physical frame allocator not initialized\n");
+    }
+}
+
+// Print "<label><value><suffix>"
+static void print_value(const char* label, uint32_t value, const char* suffix) {
+    char buffer[16];
+    terminal_writestring(label);
+    itoa(value, buffer, 10);
+    terminal_writestring(buffer);
+    terminal_writestring(suffix);
+}
+
+// Heap, size class, slab cache and call site usage
+static void system_heap(void) {
+    heap_stats_t stats;
+    heap_get_stats(&stats);
+
+    terminal_writestring("Heap Statistics:\n");
+    print_value("  In use: ", stats.bytes_in_use, " bytes");
+    print_value(" (peak ", stats.peak_bytes_in_use, " bytes)\n");
+    print_value("  Reserved: ", stats.bytes_reserved / 1024, " KB");
+    print_value(", ", stats.arena_count, " arenas\n");
+    print_value("  Allocations: ", stats.alloc_count, "");
+    print_value(", frees: ", stats.free_count, "");
+    print_value(", failed: ", stats.failed_allocs, "\n");
+    print_value("  Free: ", stats.small_free_bytes, " bytes in size classes, ");
+    print_value("", stats.large_free_bytes, " bytes in arenas\n");
+    print_value("  Largest free block: ", stats.largest_free_block, " bytes");
+    print_value(" (fragmentation ", stats.fragmentation, "%)\n");
+    print_value("  Malloc latency: ", stats.alloc_cycles_avg, " cycles avg");
+    print_value(", ", stats.alloc_cycles_max, " cycles max\n");
+
+    terminal_writestring("Size Classes (in use / free):\n");
+    for (int i = 0; i < HEAP_SIZE_CLASSES; i++) {
+        if (stats.class_in_use[i] == 0 && stats.class_free[i] == 0) {
+            continue;
+        }
+        print_value("  ", stats.class_size[i], " bytes: ");
+        print_value("", stats.class_in_use[i], " / ");
+        print_value("", stats.class_free[i], "\n");
+    }
+
+    terminal_writestring("Slab Caches (in use / peak, slabs):\n");
+    for (slab_cache_t* cache = slab_cache_first(); cache; cache = cache->next) {
+        terminal_writestring("  ");
+        terminal_writestring(cache->name);
+        print_value(": ", cache->objects_in_use, " / ");
+        print_value("", cache->peak_in_use, ", ");
+        print_value("", cache->slab_count, " slabs");
+        if (cache->failed_allocs) {
+            print_value(", ", cache->failed_allocs, " failed");
+        }
+        terminal_writestring("\n");
+    }
+
+    // Show the call sites holding the most memory
+    static heap_site_stats_t sites[HEAP_MAX_SITES];
+    uint32_t count = heap_get_sites(sites, HEAP_MAX_SITES);
+
+    terminal_writestring("Top Call Sites (bytes in use / peak, allocs / frees):\n");
+    for (int shown = 0; shown < 8 && count > 0; shown++) {
+        uint32_t best = 0;
+        for (uint32_t i = 1; i < count; i++) {
+            if (sites[i].bytes_in_use > sites[best].bytes_in_use) {
+                best = i;
+            }
+        }
+
+        char buffer[16];
+        if (sites[best].caller) {
+            terminal_writestring("  0x");
+            itoa(sites[best].caller, buffer, 16);
+            terminal_writestring(buffer);
+        } else {
+            terminal_writestring("  (other)");
+        }
+        print_value(": ", sites[best].bytes_in_use, " / ");
+        print_value("", sites[best].peak_bytes, ", ");
+        print_value("", sites[best].allocs, " / ");
+        print_value("", sites[best].frees, "\n");
+
+        sites[best] = sites[--count];
+    }
 }
 
 // Boot information from multiboot
@@ -995,7 +1022,7 @@ void cmd_system(const char* args) {
     
     // Check for empty arguments
     if (*args == '\0') {
-        terminal_writestring("Usage: system [restart|reboot|shutdown|powerdown|info]\n");
+        terminal_writestring("Usage: system [restart|reboot|shutdown|powerdown|info|heap]\n");
         return;
     }
     
@@ -1018,9 +1045,15 @@ void cmd_system(const char* args) {
         return;
     }
     
+    // Check for heap command
+    if (strncmp(args, "heap", 4) == 0) {
+        system_heap();
+        return;
+    }
+    
     // Unknown argument
     terminal_writestring("Unknown system command: ");
     terminal_writestring(args);
     terminal_writestring("\n");
-    terminal_writestring("Available commands: restart, reboot, shutdown, powerdown, info\n");
+    terminal_writestring("Available commands: restart, reboot, shutdown, powerdown, info, heap\n");
 }
@@ -38,23 +38,25 @@ void cmd_wc(const char* args) {
             return;
         }
         
-        // Count lines, words, and characters
-        char buffer[512];
-        size_t bytes_read;
+        // Count lines, words, and characters, scanning the file in place
+        const char* data;
+        uint32_t offset = 0;
+        uint32_t mapped;
         size_t lines = 0;
         size_t words = 0;
         size_t chars = 0;
         bool in_word = false;
         
-        while ((bytes_read = fs_read(file, buffer, sizeof(buffer))) > 0) {
-            for (size_t j = 0; j < bytes_read; j++) {
+        while ((data = (const char*)fs_map(file, offset, file->file_size - offset, &mapped)) != NULL) {
+            offset += mapped;
+            for (size_t j = 0; j < mapped; j++) {
                 chars++;
                 
-                if (buffer[j] == '\n') {
+                if (data[j] == '\n') {
                     lines++;
                 }
                 
-                if (buffer[j] == ' ' || buffer[j] == '\t' || buffer[j] == '\n') {
+                if (data[j] == ' ' || data[j] == '\t' || data[j] == '\n') {
                     if (in_word) {
                         words++;
                         in_word = false;
@@ -70,7 +72,14 @@ void cmd_wc(const char* args) {
             words++;
         }
         
+        bool complete = offset >= file->file_size;
         fs_close(file);
+        if (!complete) {
+            terminal_writestring("wc: Read error on ");
+            terminal_writestring(filename);
+            terminal_writestring("\n");
+            return;
+        }
         
         // Display results
         char num_str[16];
@@ -1,6 +1,7 @@
 #include "../include/disk.h"
 #include "../include/io.h"
 #include "../include/string.h"
+#include "../include/dma.h"
 #include <stddef.h>
 
 // External function declarations
@@ -17,6 +18,28 @@ uint8_t ide_read(uint8_t channel, uint8_t reg);
 void ide_write(uint8_t channel, uint8_t reg, uint8_t data);
 void ide_read_buffer(uint8_t channel, uint8_t reg, uint32_t buffer, uint32_t quads);
 
+// Give a bus master channel its descriptor table and bounce buffer
+static void ide_setup_dma(uint8_t channel) {
+    ide_channel_t* ch = &channels[channel];
+    
+    if (!ch->prdt) {
+        ch->prdt = dma_alloc(sizeof(ide_prd_t), 0, DMA_ZERO, &ch->prdt_phys);
+    }
+    if (ch->prdt && !ch->dma_buffer) {
+        ch->dma_buffer = dma_alloc(ATA_DMA_BUFFER_SIZE, 0, 0, &ch->dma_buffer_phys);
+    }
+    
+    if (!ch->prdt || !ch->dma_buffer) {
+        terminal_writestring("IDE: No DMA memory, bus mastering disabled\n");
+        return;
+    }
+    
+    ch->prdt[0].phys = ch->dma_buffer_phys;
+    ch->prdt[0].byte_count = ATA_DMA_BUFFER_SIZE & 0xFFFF;
+    ch->prdt[0].flags = ATA_PRD_LAST;
+    outl(ch->bmide + ATA_BM_PRDT, ch->prdt_phys);
+}
+
 // Initialize IDE controller
 void ide_initialize(uint32_t bar0, uint32_t bar1, uint32_t bar2, uint32_t bar3, uint32_t bar4) {
     int k, count = 0;
@@ -29,6 +52,12 @@ void ide_initialize(uint32_t bar0, uint32_t bar1, uint32_t bar2, uint32_t bar3,
     channels[ATA_PRIMARY].bmide = (bar4 & 0xFFFFFFFC) + 0; // Bus Master IDE
     channels[ATA_SECONDARY].bmide = (bar4 & 0xFFFFFFFC) + 8; // Bus Master IDE
 
+    // Bus master DMA only exists on PCI controllers that report BAR4
+    if (bar4 & 0xFFFFFFFC) {
+        ide_setup_dma(ATA_PRIMARY);
+        ide_setup_dma(ATA_SECONDARY);
+    }
+
     // 2- Disable IRQs:
     ide_write(ATA_PRIMARY, ATA_REG_CONTROL, 2);
     ide_write(ATA_SECONDARY, ATA_REG_CONTROL, 2);
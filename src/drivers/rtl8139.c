@@ -4,6 +4,7 @@
 #include "../include/io.h"
 #include "../include/pci.h"
 #include "../include/rtl8139.h"
+#include "../include/dma.h"
 #include "../include/string.h"
 
 // RTL8139 PCI IDs
@@ -53,6 +54,7 @@
 #define RTL8139_RCR_AM      0x02  // Accept multicast
 #define RTL8139_RCR_APM     0x04  // Accept physical match
 #define RTL8139_RCR_AAP     0x08  // Accept all packets
+#define RTL8139_RCR_RBLEN_SHIFT 11  // Ring size: 8K << RBLEN
 
 // Transmit configuration register bits
 #define RTL8139_TCR_IFG96   (3 << 24)
@@ -65,8 +67,11 @@
 #define RTL8139_INT_TX_ERR          0x0008
 #define RTL8139_INT_RXBUF_OVERFLOW  0x0010
 
-// Buffer sizes
-#define RTL8139_RX_BUFFER_SIZE 8192
+// Buffer sizes. The receive ring is 8K << RBLEN plus 16 bytes; with WRAP set
+// the card may also run one full frame past the end of the ring.
+#define RTL8139_RX_RING_MIN    8192
+#define RTL8139_RX_RING_MAX    32768
+#define RTL8139_RX_SLACK       (16 + 1536)
 #define RTL8139_TX_BUFFER_SIZE 1536
 
 // Device state
@@ -74,6 +79,7 @@ typedef struct {
     uint16_t io_base;
     uint8_t mac_address[6];
     uint8_t* rx_buffer;
+    uint32_t rx_buffer_size;    // Ring size without slack
     uint8_t* tx_buffer[4];
     uint16_t rx_buffer_pos;
     uint8_t tx_buffer_index;
@@ -126,25 +132,39 @@ static void rtl8139_read_mac_address(void) {
 }
 
 static bool rtl8139_init_rx_buffer(void) {
-    // Use static buffer for simplicity
-    static uint8_t rx_buffer_static[RTL8139_RX_BUFFER_SIZE + 16];
-    rtl8139_dev.rx_buffer = rx_buffer_static;
+    // Use the largest ring we can get, falling back to the minimum
+    uint32_t phys = 0;
+    for (uint32_t size = RTL8139_RX_RING_MAX; size >= RTL8139_RX_RING_MIN; size /= 2) {
+        rtl8139_dev.rx_buffer = dma_alloc(size + RTL8139_RX_SLACK, 0, DMA_ZERO, &phys);
+        if (rtl8139_dev.rx_buffer) {
+            rtl8139_dev.rx_buffer_size = size;
+            break;
+        }
+    }
+    
+    if (!rtl8139_dev.rx_buffer) {
+        return false;
+    }
     rtl8139_dev.rx_buffer_pos = 0;
     
     // Set receive buffer address
-    rtl8139_write_reg32(RTL8139_RBSTART, (uint32_t)rtl8139_dev.rx_buffer);
+    rtl8139_write_reg32(RTL8139_RBSTART, phys);
     
     return true;
 }
 
 static bool rtl8139_init_tx_buffers(void) {
-    // Use static buffers for simplicity
-    static uint8_t tx_buffer_static[4][RTL8139_TX_BUFFER_SIZE];
+    // All four transmit buffers share one contiguous DMA block
+    uint32_t phys = 0;
+    uint8_t* block = dma_alloc(4 * RTL8139_TX_BUFFER_SIZE, 0, 0, &phys);
+    if (!block) {
+        return false;
+    }
     
     for (int i = 0; i < 4; i++) {
-        rtl8139_dev.tx_buffer[i] = tx_buffer_static[i];
+        rtl8139_dev.tx_buffer[i] = block + i * RTL8139_TX_BUFFER_SIZE;
         // Set transmit buffer address
-        rtl8139_write_reg32(RTL8139_TSAD0 + (i * 4), (uint32_t)rtl8139_dev.tx_buffer[i]);
+        rtl8139_write_reg32(RTL8139_TSAD0 + (i * 4), phys + i * RTL8139_TX_BUFFER_SIZE);
     }
     
     rtl8139_dev.tx_buffer_index = 0;
@@ -157,6 +177,9 @@ static void rtl8139_configure(void) {
     
     // Configure receive settings
     uint32_t rx_config = RTL8139_RCR_AB | RTL8139_RCR_AM | RTL8139_RCR_APM | RTL8139_RCR_AAP | RTL8139_RCR_WRAP;
+    for (uint32_t size = RTL8139_RX_RING_MIN; size < rtl8139_dev.rx_buffer_size; size *= 2) {
+        rx_config += 1 << RTL8139_RCR_RBLEN_SHIFT;
+    }
     rtl8139_write_reg32(RTL8139_RCR, rx_config);
     
     // Configure transmit settings
@@ -289,7 +312,7 @@ int rtl8139_receive_packet(uint8_t* buffer, uint16_t max_length) {
     
     // Update buffer position
     rtl8139_dev.rx_buffer_pos = (rtl8139_dev.rx_buffer_pos + packet_length + 4 + 3) & ~3; // Align to 4 bytes
-    rtl8139_dev.rx_buffer_pos %= RTL8139_RX_BUFFER_SIZE;
+    rtl8139_dev.rx_buffer_pos %= rtl8139_dev.rx_buffer_size;
     
     // Update CAPR register
     rtl8139_write_reg16(RTL8139_CAPR, rtl8139_dev.rx_buffer_pos - 16);
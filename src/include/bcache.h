@@ -0,0 +1,76 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BCACHE_BLOCK_SIZE      512
+#define BCACHE_DEFAULT_BUFFERS 256     // 128KB of cached sectors
+#define BCACHE_HASH_BUCKETS    64
+#define BCACHE_MAX_DEVICES     4
+#define BCACHE_PREFETCH_MAX    64      // Sectors per readahead request
+
+// Device numbers
+#define BCACHE_DEV_RAMDISK     0
+
+// Block device callbacks; count is in sectors
+typedef bool (*bcache_read_fn)(uint32_t lba, uint32_t count, void* buffer);
+typedef bool (*bcache_write_fn)(uint32_t lba, uint32_t count, const void* buffer);
+
+// One cached sector
+typedef struct bcache_buf {
+    uint32_t device;
+    uint32_t lba;
+    uint32_t refcount;              // Holders; referenced buffers are never evicted
+    bool     valid;                 // Data matches (or supersedes) the device
+    bool     dirty;                 // Must be written back before reuse
+    struct bcache_buf* hash_next;
+    struct bcache_buf* lru_prev;    // LRU list, most recently used first
+    struct bcache_buf* lru_next;
+    uint8_t* data;
+} bcache_buf_t;
+
+typedef struct {
+    uint32_t buffers;
+    uint32_t valid;
+    uint32_t dirty;
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t device_reads;          // Read requests sent to devices
+    uint32_t device_writes;         // Write requests sent to devices
+    uint32_t writebacks;            // Dirty sectors written back
+    uint32_t evictions;
+    uint32_t prefetched;            // Sectors brought in by readahead
+} bcache_stats_t;
+
+// Set up the cache with the given number of sector buffers. Safe to call again.
+bool bcache_init(uint32_t buffers);
+bool bcache_register_device(uint32_t device, bcache_read_fn read, bcache_write_fn write);
+
+// Referenced access to one sector. bcache_get() reads the sector in unless
+// 'fill' is false (the caller is about to overwrite all of it).
+bcache_buf_t* bcache_get(uint32_t device, uint32_t lba, bool fill);
+void bcache_mark_dirty(bcache_buf_t* buf);
+void bcache_release(bcache_buf_t* buf);
+
+// Multi-sector copies through the cache. Writes are write-back.
+bool bcache_read(uint32_t device, uint32_t lba, uint32_t count, void* buffer);
+bool bcache_write(uint32_t device, uint32_t lba, uint32_t count, const void* buffer);
+
+// One device request between the caller's memory and the disk, without
+// taking buffers. Cached sectors in the range stay coherent.
+bool bcache_read_direct(uint32_t device, uint32_t lba, uint32_t count, void* buffer);
+bool bcache_write_direct(uint32_t device, uint32_t lba, uint32_t count, const void* buffer);
+
+// Read sectors into the cache ahead of use. Cached sectors are skipped and
+// each run of missing ones is a single device request.
+bool bcache_prefetch(uint32_t device, uint32_t lba, uint32_t count);
+
+// Write back dirty sectors of a device, or drop its sectors entirely
+bool bcache_sync(uint32_t device);
+bool bcache_sync_range(uint32_t device, uint32_t lba, uint32_t count);
+void bcache_invalidate(uint32_t device);
+
+void bcache_get_stats(bcache_stats_t* stats);
+
+#endif /* BCACHE_H */
@@ -0,0 +1,35 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// CPUID leaf 1 EDX
+#define CPU_FEATURE_FPU   (1 << 0)
+#define CPU_FEATURE_PSE   (1 << 3)
+#define CPU_FEATURE_TSC   (1 << 4)
+#define CPU_FEATURE_PGE   (1 << 13)
+#define CPU_FEATURE_FXSR  (1 << 24)
+#define CPU_FEATURE_SSE   (1 << 25)
+#define CPU_FEATURE_SSE2  (1 << 26)
+
+// CPUID leaf 7 (subleaf 0) EBX
+#define CPU_FEATURE7_ERMS (1 << 9)   // Enhanced REP MOVSB/STOSB
+
+// Probe CPUID once and turn on SSE (CR0/CR4) when the CPU has it.
+// Must run before anything that asks for features or copies memory with SSE.
+void cpu_init(void);
+
+bool cpu_has_cpuid(void);
+void cpu_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx);
+
+// Cached feature words from cpu_init(); 0 when CPUID is missing
+uint32_t cpu_get_max_leaf(void);
+uint32_t cpu_get_features_edx(void);
+uint32_t cpu_get_features_ecx(void);
+uint32_t cpu_get_features7_ebx(void);
+
+// SSE registers may be used by the kernel
+bool cpu_sse_enabled(void);
+
+#endif /* CPU_H */
@@ -96,12 +96,32 @@ typedef struct {
     uint8_t  model[41];   // Model in string.
 } ide_device_t;
 
+// Bus master IDE registers (offsets from bmide)
+#define ATA_BM_COMMAND  0x00
+#define ATA_BM_STATUS   0x02
+#define ATA_BM_PRDT     0x04
+
+// Bus master transfers go through one bounce buffer per channel
+#define ATA_DMA_BUFFER_SIZE 0x10000
+#define ATA_PRD_LAST        0x8000
+
+// Physical Region Descriptor
+typedef struct {
+    uint32_t phys;        // Buffer physical address
+    uint16_t byte_count;  // 0 means 64KB
+    uint16_t flags;       // ATA_PRD_LAST on the final entry
+} __attribute__((packed)) ide_prd_t;
+
 // Channel structure
 typedef struct {
     uint16_t base;  // I/O Base.
     uint16_t ctrl;  // Control Base
     uint16_t bmide; // Bus Master IDE
     uint8_t  nien;  // nIEN (No Interrupt);
+    ide_prd_t* prdt;          // Descriptor table (NULL without bus mastering)
+    uint32_t prdt_phys;
+    uint8_t* dma_buffer;      // Bounce buffer described by the PRDT
+    uint32_t dma_buffer_phys;
 } ide_channel_t;
 
 // Function prototypes - Fixed return types
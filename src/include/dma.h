@@ -0,0 +1,30 @@
+#ifndef DMA_H
+#define DMA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Largest single DMA buffer; buffers never cross a 64KB physical boundary
+#define DMA_MAX_SIZE   0x10000
+
+// ISA DMA can only address the first 16MB
+#define DMA_ISA_LIMIT  0x1000000
+
+// dma_alloc() flags
+#define DMA_BELOW_16MB 0x01     // Buffer must lie below DMA_ISA_LIMIT
+#define DMA_ZERO       0x02     // Clear the buffer before returning it
+
+// Set aside the low DMA zone. Call after pmm_init().
+void dma_init(void);
+
+// Allocate a physically contiguous buffer of up to DMA_MAX_SIZE bytes,
+// aligned to 'align' (power of two, at least a frame). The physical address
+// is stored in *phys if phys is not NULL. Returns NULL on failure.
+void* dma_alloc(size_t size, uint32_t align, uint32_t flags, uint32_t* phys);
+void dma_free(void* buffer, size_t size);
+
+// Physical address of a kernel virtual address
+uint32_t virt_to_phys(const void* virt);
+
+#endif /* DMA_H */
@@ -125,8 +125,27 @@ typedef struct {
     uint16_t name3[2];              // Last 2 characters (UTF-16)
 } __attribute__((packed)) fat32_lfn_entry_t;
 
-// File handle structure
+// A run of consecutive clusters in a file's chain
+typedef struct {
+    uint32_t file_cluster;          // Index of the run's first cluster within the file
+    uint32_t start_cluster;         // First cluster on disk
+    uint32_t length;                // Clusters in the run
+} fs_extent_t;
+
+// One piece of a vectored read
 typedef struct {
+    void* base;
+    size_t length;
+} fs_iovec_t;
+
+// One piece of a vectored write
+typedef struct {
+    const void* base;
+    size_t length;
+} fs_const_iovec_t;
+
+// File handle structure
+typedef struct fs_file_handle {
     bool     in_use;                // Is this handle in use?
     uint32_t first_cluster;         // First cluster of file
     uint32_t current_cluster;       // Current cluster
@@ -136,6 +155,23 @@ typedef struct {
     uint8_t  attributes;            // File attributes
     char     filename[FS_MAX_NAME_LENGTH]; // Filename
     bool     is_directory;          // Is this a directory?
+    fs_extent_t* extents;           // Cluster chain as runs (NULL if unavailable)
+    uint32_t extent_count;          // Runs in use
+    uint32_t extent_capacity;       // Runs allocated
+    uint32_t cluster_count;         // Clusters in the chain
+    uint32_t grow_window;           // Clusters to add on the next extension (0 = not grown)
+    uint32_t reserved_clusters;     // Clusters kept at close (fs_fallocate)
+    uint32_t dir_cluster;           // Directory cluster holding the file's entry
+    uint32_t dir_index;             // Entry slot within that directory
+    bool     entry_dirty;           // Size or first cluster not yet in the entry
+    uint8_t* buffer;                // Cluster buffer, allocated on first use
+    uint32_t buffer_cluster;        // Cluster held in buffer, 0 if none
+    bool     buffer_dirty;          // Buffer holds data not yet written
+    uint32_t ra_last;               // Cluster index of the last read
+    uint32_t ra_window;             // Readahead window in clusters (0 = random access)
+    uint32_t ra_end;                // Cluster index just past the readahead
+    bool     direct;                // Opened with 'd': whole clusters skip the buffers
+    struct fs_file_handle* next_open; // Open handle list
 } fs_file_handle_t;
 
 // Filesystem state
@@ -150,6 +186,14 @@ typedef struct {
     uint32_t total_clusters;        // Total number of clusters
     uint32_t free_clusters;         // Number of free clusters
     uint32_t next_free_cluster;     // Next free cluster hint
+    uint32_t* fat;                  // In-memory copy of the first FAT
+    uint32_t* free_map;             // One bit per cluster, set = free
+    uint32_t free_map_words;        // Size of free_map in 32-bit words
+    bool     free_map_ready;        // free_map has been built from the FAT
+    uint32_t fsinfo_sector;         // FSInfo sector, 0 if the volume has none
+    uint32_t fat_sectors;           // FAT sectors held in memory
+    uint32_t* fat_dirty;            // One bit per in-memory FAT sector
+    uint32_t fat_dirty_count;       // Sectors waiting to be written
     fat32_boot_sector_t boot_sector; // Boot sector
 } fat32_fs_t;
 
@@ -176,14 +220,39 @@ bool fs_init(void);
 bool fs_mount(void);
 void fs_unmount(void);
 
-// File operations
+// File operations. Mode is "r", "w" or "a"; adding 'd' (e.g. "rd") asks
+// for direct I/O, where whole clusters at cluster-aligned positions move
+// between the caller's buffer and the disk without any buffering, one
+// request per run of adjacent clusters.
 fs_file_handle_t* fs_open(const char* path, const char* mode);
 void fs_close(fs_file_handle_t* handle);
 size_t fs_read(fs_file_handle_t* handle, void* buffer, size_t size);
 size_t fs_write(fs_file_handle_t* handle, const void* buffer, size_t size);
 bool fs_seek(fs_file_handle_t* handle, uint32_t position);
+
+// Vectored I/O: the pieces are transferred in order as if by consecutive
+// fs_read/fs_write calls, but the chain is walked once for the batch, the
+// write is sized and allocated for the whole batch and the FAT is written
+// back once. Both return the total number of bytes moved and stop at the
+// first short piece.
+size_t fs_readv(fs_file_handle_t* handle, const fs_iovec_t* iov, int count);
+size_t fs_writev(fs_file_handle_t* handle, const fs_const_iovec_t* iov, int count);
+bool fs_flush(fs_file_handle_t* handle);
 uint32_t fs_tell(fs_file_handle_t* handle);
 
+// Reserve space so the file can grow to 'bytes' without further allocation.
+// Clusters are taken in contiguous runs where possible; the size is unchanged.
+bool fs_fallocate(fs_file_handle_t* handle, uint32_t bytes);
+
+// Read the file in place. Returns a read-only pointer to the data at
+// 'offset' and stores how many bytes it covers in *mapped, which can be
+// less than 'length': a mapping ends where the file's clusters stop being
+// adjacent. The pointer is valid until the handle is next used or the
+// file is written. Returns NULL at end of file, and also on an I/O error,
+// when out of memory or when the chain is shorter than the file, so a
+// caller walking the file should check it got to file_size.
+const void* fs_map(fs_file_handle_t* handle, uint32_t offset, uint32_t length, uint32_t* mapped);
+
 // Directory operations
 bool fs_mkdir(const char* path);
 bool fs_rmdir(const char* path);
@@ -191,9 +260,15 @@ bool fs_list_directory(const char* path, void (*callback)(const char* name, bool
 bool fs_chdir(const char* path);
 const char* fs_getcwd(void);
 
+// Write back buffered file data, directory entries and the FAT
+bool fs_sync(void);
+
 // File management
 bool fs_delete(const char* path);
 bool fs_rename(const char* old_path, const char* new_path);
+// Copy a file to a new path, cluster runs at a time, through the request
+// queue. Fails if the destination exists; a partial copy is removed.
+bool fs_copy(const char* src_path, const char* dst_path);
 bool fs_exists(const char* path);
 uint32_t fs_get_file_size(const char* path);
 
@@ -206,7 +281,9 @@ uint32_t fs_get_total_space(void);
 uint32_t fat32_read_fat_entry(uint32_t cluster);
 bool fat32_write_fat_entry(uint32_t cluster, uint32_t value);
 uint32_t fat32_allocate_cluster(void);
+uint32_t fat32_allocate_run(uint32_t count, uint32_t goal, uint32_t* allocated);
 bool fat32_free_cluster_chain(uint32_t start_cluster);
+bool fat32_flush_fat(void);
 bool fat32_read_cluster(uint32_t cluster, void* buffer);
 bool fat32_write_cluster(uint32_t cluster, const void* buffer);
 
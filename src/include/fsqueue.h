@@ -0,0 +1,83 @@
+#ifndef FSQUEUE_H
+#define FSQUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesystem.h"
+
+// Bytes a read, write or copy request moves per fsq_poll() step. A
+// multiple of every cluster size, so direct handles keep whole-cluster
+// transfers.
+#define FSQ_SLICE (32 * 1024)
+
+typedef enum {
+    FSQ_OPEN,
+    FSQ_READ,
+    FSQ_WRITE,
+    FSQ_COPY,
+    FSQ_CLOSE
+} fsq_op_t;
+
+typedef enum {
+    FSQ_IDLE,                       // Not submitted
+    FSQ_QUEUED,                     // Waiting or in progress
+    FSQ_DONE,
+    FSQ_FAILED
+} fsq_status_t;
+
+struct fsq_request;
+typedef void (*fsq_callback_t)(struct fsq_request* request);
+
+// A filesystem request. The caller owns the storage, which starts out
+// zeroed, and the request (with its path, mode and buffer) must stay valid
+// until it completes.
+typedef struct fsq_request {
+    fsq_op_t op;
+    fsq_status_t status;
+    const char* path;               // FSQ_OPEN
+    const char* mode;               // FSQ_OPEN
+    fs_file_handle_t* handle;       // Result of FSQ_OPEN, target of the others
+    fs_file_handle_t* target;       // FSQ_COPY destination; 'handle' is the source
+    void* buffer;                   // FSQ_READ / FSQ_WRITE
+    size_t length;
+    size_t done;                    // Bytes moved so far; short at end of file
+    fsq_callback_t callback;        // Called on completion, may be NULL
+    void* context;                  // For the callback
+    struct fsq_request* next;
+} fsq_request_t;
+
+// Queue a request. Requests run one after another in submission order, so
+// a read queued after an open on the same handle sees the open's result.
+bool fsq_submit(fsq_request_t* request);
+
+// Fill in and submit a request
+bool fsq_open(fsq_request_t* request, const char* path, const char* mode,
+              fsq_callback_t callback, void* context);
+bool fsq_read(fsq_request_t* request, fs_file_handle_t* handle, void* buffer, size_t length,
+              fsq_callback_t callback, void* context);
+bool fsq_write(fsq_request_t* request, fs_file_handle_t* handle, const void* buffer, size_t length,
+               fsq_callback_t callback, void* context);
+bool fsq_close(fsq_request_t* request, fs_file_handle_t* handle,
+               fsq_callback_t callback, void* context);
+
+// Copy 'length' bytes from the start of 'src' to the position of 'dst'.
+// Each step writes one run of the source viewed in place with fs_map, so
+// no buffer sits between the two files.
+bool fsq_copy(fsq_request_t* request, fs_file_handle_t* src, fs_file_handle_t* dst, size_t length,
+              fsq_callback_t callback, void* context);
+
+// Do one step of work: an open or close, or one slice of a transfer or copy.
+// Callbacks run from here and may submit further requests. Returns true
+// while requests remain.
+bool fsq_poll(void);
+
+// Completion state of a request, for callers that poll instead of
+// taking a callback
+bool fsq_is_done(const fsq_request_t* request);
+
+// Run the queue until the request completes, keeping the keyboard and
+// network serviced between steps. Returns true if it succeeded.
+bool fsq_wait(fsq_request_t* request);
+
+#endif /* FSQUEUE_H */
@@ -6,4 +6,8 @@
 // Kernel utility functions
 void wait(uint32_t milliseconds);
 
+// Service the keyboard, network and DHCP timer once. The main loop does
+// this every pass; code that runs for a long time calls it to keep them going.
+void kernel_poll_devices(void);
+
 #endif /* KERNEL_H */
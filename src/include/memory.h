@@ -2,6 +2,10 @@
 #define MEMORY_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+#define HEAP_SIZE_CLASSES 15    // Small-object size classes
+#define HEAP_MAX_SITES    64    // Distinct allocation call sites tracked
 
 void* kmalloc(size_t size);
 void kfree(void* ptr);
@@ -12,4 +16,38 @@ void free(void* ptr);
 void* realloc(void* ptr, size_t size);
 void* calloc(size_t num, size_t size);
 
+// Allocation counters for one call site (the caller of malloc/kmalloc/...)
+typedef struct {
+    uint32_t caller;            // Return address of the allocating call, 0 = overflow
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t bytes_in_use;
+    uint32_t peak_bytes;
+} heap_site_stats_t;
+
+// Snapshot of heap state, filled in by heap_get_stats()
+typedef struct {
+    uint32_t bytes_in_use;          // Block bytes handed out, headers included
+    uint32_t peak_bytes_in_use;
+    uint32_t bytes_reserved;        // Bytes of frames currently owned by the heap
+    uint32_t alloc_count;
+    uint32_t free_count;
+    uint32_t failed_allocs;
+    uint32_t arena_count;
+    uint32_t small_free_bytes;      // Free chunks cached in the size classes
+    uint32_t large_free_bytes;      // Free bytes in the arena bins
+    uint32_t largest_free_block;
+    uint32_t fragmentation;         // Percent, 100 * (1 - largest / large free)
+    uint32_t alloc_cycles_avg;      // Moving average of malloc latency (TSC cycles)
+    uint32_t alloc_cycles_max;
+    uint32_t class_size[HEAP_SIZE_CLASSES];     // Chunk size, header included
+    uint32_t class_in_use[HEAP_SIZE_CLASSES];   // Chunks handed out
+    uint32_t class_free[HEAP_SIZE_CLASSES];     // Chunks on the free list
+} heap_stats_t;
+
+void heap_get_stats(heap_stats_t* stats);
+
+// Copy up to max_sites call-site records, returns how many were copied
+uint32_t heap_get_sites(heap_site_stats_t* sites, uint32_t max_sites);
+
 #endif /* MEMORY_H */
@@ -13,6 +13,10 @@
 #define IP_PROTOCOL_TCP  6
 #define IP_PROTOCOL_UDP  17
 
+// Size of a frame buffer from network_alloc_frame(): a full 1514 byte
+// frame rounded up to a cache line multiple
+#define NETWORK_FRAME_SIZE 1536
+
 // ARP constants
 #define ARP_HARDWARE_ETHERNET 1
 #define ARP_OPERATION_REQUEST 1
@@ -91,6 +95,10 @@ uint16_t network_checksum(const void* data, size_t length);
 uint32_t ip_str_to_int(const char* ip_str);
 void ip_int_to_str(uint32_t ip, char* str);
 
+// Frame buffers
+uint8_t* network_alloc_frame(void);
+void network_free_frame(uint8_t* frame);
+
 // Packet sending functions
 bool network_send_ethernet_frame(const uint8_t* dest_mac, uint16_t ethertype, const void* payload, uint16_t payload_len);
 bool network_send_ip_packet(uint32_t dest_ip, uint8_t protocol, const void* payload, uint16_t payload_len);
@@ -0,0 +1,35 @@
+#ifndef PMM_H
+#define PMM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "multiboot.h"
+
+// Physical frame size (one x86 page)
+#define PMM_FRAME_SIZE  4096
+#define PMM_FRAME_SHIFT 12
+
+// Everything below 1MB is left to the BIOS, VGA and the bootloader
+#define PMM_LOW_MEMORY_LIMIT 0x100000
+
+// Physical frame allocator. Addresses are physical; 0 means failure
+// since frame 0 is never handed out.
+void pmm_init(const multiboot_info_t* mbi);
+uint32_t pmm_alloc_frame(void);
+uint32_t pmm_alloc_frames(uint32_t count, uint32_t align_frames, uint32_t limit);
+void pmm_free_frame(uint32_t addr);
+void pmm_free_frames(uint32_t addr, uint32_t count);
+
+// Mark a physical range as in use (rounded outwards to frame boundaries)
+void pmm_reserve_region(uint32_t base, uint32_t length);
+
+// Statistics
+bool pmm_is_initialized(void);
+uint32_t pmm_get_total_frames(void);
+uint32_t pmm_get_free_frames(void);
+uint32_t pmm_get_highest_address(void);
+
+// Where the frame bitmap lives, so it can be mapped once paging is on
+void pmm_get_bitmap_region(uint32_t* base, uint32_t* size);
+
+#endif /* PMM_H */
@@ -0,0 +1,36 @@
+#ifndef RAMDISK_H
+#define RAMDISK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RAMDISK_SECTOR_SIZE      512
+#define RAMDISK_PAGE_SIZE        4096
+#define RAMDISK_SECTORS_PER_PAGE (RAMDISK_PAGE_SIZE / RAMDISK_SECTOR_SIZE)
+
+// Size limits for ramdisk_pick_size()
+#define RAMDISK_MIN_SIZE (4 * 1024 * 1024)
+#define RAMDISK_MAX_SIZE (256 * 1024 * 1024)
+
+// Sparse RAM disk. Pages are allocated and zero-filled on first write;
+// reads of pages that were never written return zeros.
+bool ramdisk_create(uint32_t sectors);
+void ramdisk_destroy(void);
+bool ramdisk_is_ready(void);
+
+bool ramdisk_read_sectors(uint32_t sector, uint32_t count, void* buffer);
+bool ramdisk_write_sectors(uint32_t sector, uint32_t count, const void* buffer);
+
+// Read-only pointer to the disk contents at 'sector'. *count is the number
+// of sectors wanted on entry and the number reachable from the pointer on
+// return; that stops early where the backing pages are not adjacent in
+// memory. Never-written pages map to a shared page of zeros.
+const void* ramdisk_map_sectors(uint32_t sector, uint32_t* count);
+
+// A disk size (in sectors) suited to the memory that is currently free
+uint32_t ramdisk_pick_size(void);
+
+uint32_t ramdisk_get_sector_count(void);
+uint32_t ramdisk_get_resident_pages(void);
+
+#endif /* RAMDISK_H */
@@ -0,0 +1,44 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SLAB_CACHE_LINE_SIZE 64
+#define SLAB_NAME_LENGTH     16
+
+// Optional constructor, run once per object when its slab is created.
+// Objects must be handed back to slab_free() in their constructed state.
+typedef void (*slab_ctor_t)(void* obj);
+
+typedef struct slab slab_t;
+
+// Object cache for one fixed-size object type
+typedef struct slab_cache {
+    char name[SLAB_NAME_LENGTH];
+    uint32_t object_size;           // Requested object size
+    uint32_t stride;                // Object size rounded up to alignment
+    uint32_t objects_per_slab;
+    uint32_t slab_pages;            // Frames per slab (power of two)
+    uint32_t first_object_offset;   // Offset of object 0 within a slab
+    slab_ctor_t ctor;
+    slab_t* partial;                // Slabs with free and used objects
+    slab_t* full;                   // Slabs with no free objects
+    slab_t* empty;                  // Fully free slabs kept for reuse
+    uint32_t slab_count;
+    uint32_t objects_in_use;
+    uint32_t peak_in_use;
+    uint32_t alloc_count;
+    uint32_t free_count;
+    uint32_t failed_allocs;
+    struct slab_cache* next;        // Global cache list
+} slab_cache_t;
+
+slab_cache_t* slab_cache_create(const char* name, size_t size, size_t align, slab_ctor_t ctor);
+void* slab_alloc(slab_cache_t* cache);
+void slab_free(slab_cache_t* cache, void* obj);
+
+// Walk all caches (for reporting)
+slab_cache_t* slab_cache_first(void);
+
+#endif /* SLAB_H */
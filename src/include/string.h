@@ -22,6 +22,12 @@ int atoi(const char* str);
 // Memory functions
 void* memset(void* ptr, int value, size_t num);
 void* memcpy(void* dest, const void* src, size_t n);
+void* memmove(void* dest, const void* src, size_t n);
 int memcmp(const void* ptr1, const void* ptr2, size_t num);
+void* memchr(const void* ptr, int value, size_t num);
+void* memrchr(const void* ptr, int value, size_t num);   // Last occurrence
+
+// Select memcpy/memset strategies for this CPU (after cpu_init())
+void string_init(void);
 
 #endif /* STRING_H */
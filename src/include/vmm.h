@@ -0,0 +1,39 @@
+#ifndef VMM_H
+#define VMM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "multiboot.h"
+
+#define VMM_PAGE_SIZE       4096
+#define VMM_LARGE_PAGE_SIZE 0x400000
+
+// Page table entry flags
+#define VMM_PAGE_PRESENT       0x001
+#define VMM_PAGE_WRITE         0x002
+#define VMM_PAGE_USER          0x004
+#define VMM_PAGE_WRITE_THROUGH 0x008
+#define VMM_PAGE_NO_CACHE      0x010
+#define VMM_PAGE_LARGE         0x080   // PDE maps a 4MB page (PSE)
+#define VMM_PAGE_GLOBAL        0x100
+
+// Page tables are reachable through the last directory slot
+#define VMM_RECURSIVE_BASE  0xFFC00000
+
+// Build the kernel address space and turn paging on. The kernel image and
+// the frame bitmap are identity mapped (4MB pages when the CPU has PSE);
+// everything else has to be mapped with vmm_map() before it is touched.
+void vmm_init(const multiboot_info_t* mbi);
+
+// Map 'count' 4KB pages starting at virt to consecutive frames at phys.
+// Pages already covered by a matching identity large page are left alone.
+bool vmm_map(uint32_t virt, uint32_t phys, uint32_t count, uint32_t flags);
+void vmm_unmap(uint32_t virt, uint32_t count);
+
+// Physical address behind virt, or 0 if it is not mapped
+uint32_t vmm_get_physical(uint32_t virt);
+
+bool vmm_is_enabled(void);
+bool vmm_has_large_pages(void);
+
+#endif /* VMM_H */
@@ -0,0 +1,491 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/bcache.h"
+#include "../include/memory.h"
+#include "../include/string.h"
+
+extern void terminal_writestring(const char* data);
+
+// Buffer cache
+//
+// A fixed pool of sector buffers keyed by (device, LBA). Lookups go through
+// a small hash table; every buffer also sits on one LRU list, and eviction
+// takes the least recently used buffer nobody holds a reference to. Writes
+// only dirty the buffer; the device sees them when the buffer is evicted or
+// the device is synced.
+//
+// Runs of missing sectors are read from the device in one request. Very
+// large transfers bypass the pool so one big file copy cannot flush out
+// the FAT and directory sectors everything else depends on.
+
+typedef struct {
+    bcache_read_fn read;
+    bcache_write_fn write;
+} bcache_device_t;
+
+static bcache_buf_t* bcache_bufs = NULL;
+static uint8_t* bcache_data = NULL;
+static uint32_t bcache_count = 0;
+static bcache_buf_t* bcache_hash[BCACHE_HASH_BUCKETS];
+static bcache_buf_t* lru_head = NULL;
+static bcache_buf_t* lru_tail = NULL;
+static bcache_device_t bcache_devices[BCACHE_MAX_DEVICES];
+static bcache_stats_t bcache_stats;
+static uint8_t bcache_staging[BCACHE_PREFETCH_MAX * BCACHE_BLOCK_SIZE];
+
+static inline uint32_t bcache_hash_index(uint32_t device, uint32_t lba) {
+    return ((lba ^ (device << 24)) * 2654435761u) >> 26;
+}
+
+static inline bool bcache_device_ok(uint32_t device) {
+    return bcache_bufs && device < BCACHE_MAX_DEVICES && bcache_devices[device].read;
+}
+
+// Transfers longer than this go straight to the device
+static inline uint32_t bcache_bypass_limit(void) {
+    return bcache_count / 4;
+}
+
+static void lru_remove(bcache_buf_t* buf) {
+    if (buf->lru_prev) {
+        buf->lru_prev->lru_next = buf->lru_next;
+    } else {
+        lru_head = buf->lru_next;
+    }
+    if (buf->lru_next) {
+        buf->lru_next->lru_prev = buf->lru_prev;
+    } else {
+        lru_tail = buf->lru_prev;
+    }
+}
+
+static void lru_push_front(bcache_buf_t* buf) {
+    buf->lru_prev = NULL;
+    buf->lru_next = lru_head;
+    if (lru_head) {
+        lru_head->lru_prev = buf;
+    } else {
+        lru_tail = buf;
+    }
+    lru_head = buf;
+}
+
+static void lru_push_back(bcache_buf_t* buf) {
+    buf->lru_next = NULL;
+    buf->lru_prev = lru_tail;
+    if (lru_tail) {
+        lru_tail->lru_next = buf;
+    } else {
+        lru_head = buf;
+    }
+    lru_tail = buf;
+}
+
+static inline void lru_touch(bcache_buf_t* buf) {
+    if (buf != lru_head) {
+        lru_remove(buf);
+        lru_push_front(buf);
+    }
+}
+
+static bcache_buf_t* bcache_lookup(uint32_t device, uint32_t lba) {
+    bcache_buf_t* buf = bcache_hash[bcache_hash_index(device, lba)];
+    while (buf) {
+        if (buf->lba == lba && buf->device == device) {
+            return buf;
+        }
+        buf = buf->hash_next;
+    }
+    return NULL;
+}
+
+static void bcache_hash_insert(bcache_buf_t* buf) {
+    uint32_t index = bcache_hash_index(buf->device, buf->lba);
+    buf->hash_next = bcache_hash[index];
+    bcache_hash[index] = buf;
+}
+
+static void bcache_hash_remove(bcache_buf_t* buf) {
+    bcache_buf_t** link = &bcache_hash[bcache_hash_index(buf->device, buf->lba)];
+    while (*link) {
+        if (*link == buf) {
+            *link = buf->hash_next;
+            break;
+        }
+        link = &(*link)->hash_next;
+    }
+    buf->hash_next = NULL;
+}
+
+static bool bcache_writeback(bcache_buf_t* buf) {
+    if (!buf->dirty) {
+        return true;
+    }
+    if (!bcache_devices[buf->device].write(buf->lba, 1, buf->data)) {
+        return false;
+    }
+    bcache_stats.device_writes++;
+    bcache_stats.writebacks++;
+    buf->dirty = false;
+    return true;
+}
+
+// Take the least recently used unreferenced buffer and detach it
+static bcache_buf_t* bcache_evict(void) {
+    for (bcache_buf_t* buf = lru_tail; buf; buf = buf->lru_prev) {
+        if (buf->refcount > 0) {
+            continue;
+        }
+        if (buf->valid) {
+            if (!bcache_writeback(buf)) {
+                continue;
+            }
+            bcache_hash_remove(buf);
+            buf->valid = false;
+            bcache_stats.evictions++;
+        }
+        return buf;
+    }
+    return NULL;
+}
+
+// Give an evicted buffer a new identity
+static void bcache_assign(bcache_buf_t* buf, uint32_t device, uint32_t lba) {
+    buf->device = device;
+    buf->lba = lba;
+    buf->valid = true;
+    buf->dirty = false;
+    bcache_hash_insert(buf);
+    lru_touch(buf);
+}
+
+bool bcache_init(uint32_t buffers) {
+    if (bcache_bufs) {
+        return true;
+    }
+    if (buffers == 0) {
+        return false;
+    }
+
+    bcache_bufs = (bcache_buf_t*)calloc(buffers, sizeof(bcache_buf_t));
+    bcache_data = (uint8_t*)malloc(buffers * BCACHE_BLOCK_SIZE);
+    if (!bcache_bufs || !bcache_data) {
+        free(bcache_bufs);
+        free(bcache_data);
+        bcache_bufs = NULL;
+        bcache_data = NULL;
+        terminal_writestring("BCACHE: Out of memory for buffers\n");
+        return false;
+    }
+
+    bcache_count = buffers;
+    memset(bcache_hash, 0, sizeof(bcache_hash));
+    memset(&bcache_stats, 0, sizeof(bcache_stats));
+    lru_head = NULL;
+    lru_tail = NULL;
+    for (uint32_t i = 0; i < buffers; i++) {
+        bcache_bufs[i].data = bcache_data + i * BCACHE_BLOCK_SIZE;
+        lru_push_back(&bcache_bufs[i]);
+    }
+
+    return true;
+}
+
+bool bcache_register_device(uint32_t device, bcache_read_fn read, bcache_write_fn write) {
+    if (device >= BCACHE_MAX_DEVICES || !read || !write) {
+        return false;
+    }
+    bcache_devices[device].read = read;
+    bcache_devices[device].write = write;
+    return true;
+}
+
+bcache_buf_t* bcache_get(uint32_t device, uint32_t lba, bool fill) {
+    if (!bcache_device_ok(device)) {
+        return NULL;
+    }
+
+    bcache_buf_t* buf = bcache_lookup(device, lba);
+    if (buf) {
+        bcache_stats.hits++;
+        buf->refcount++;
+        lru_touch(buf);
+        return buf;
+    }
+
+    bcache_stats.misses++;
+    buf = bcache_evict();
+    if (!buf) {
+        return NULL; // Every buffer is referenced
+    }
+
+    if (fill) {
+        bcache_stats.device_reads++;
+        if (!bcache_devices[device].read(lba, 1, buf->data)) {
+            return NULL;
+        }
+    }
+
+    bcache_assign(buf, device, lba);
+    buf->refcount = 1;
+    return buf;
+}
+
+void bcache_mark_dirty(bcache_buf_t* buf) {
+    if (buf) {
+        buf->dirty = true;
+    }
+}
+
+void bcache_release(bcache_buf_t* buf) {
+    if (buf && buf->refcount > 0) {
+        buf->refcount--;
+    }
+}
+
+bool bcache_read(uint32_t device, uint32_t lba, uint32_t count, void* buffer) {
+    if (!bcache_device_ok(device)) {
+        return false;
+    }
+
+    uint8_t* dst = (uint8_t*)buffer;
+    uint32_t i = 0;
+    while (i < count) {
+        bcache_buf_t* buf = bcache_lookup(device, lba + i);
+        if (buf) {
+            bcache_stats.hits++;
+            memcpy(dst + i * BCACHE_BLOCK_SIZE, buf->data, BCACHE_BLOCK_SIZE);
+            lru_touch(buf);
+            i++;
+            continue;
+        }
+
+        // Read the whole run of missing sectors at once
+        uint32_t run = 1;
+        while (i + run < count && !bcache_lookup(device, lba + i + run)) {
+            run++;
+        }
+
+        bcache_stats.misses += run;
+        bcache_stats.device_reads++;
+        uint8_t* run_dst = dst + i * BCACHE_BLOCK_SIZE;
+        if (!bcache_devices[device].read(lba + i, run, run_dst)) {
+            return false;
+        }
+
+        if (run <= bcache_bypass_limit()) {
+            for (uint32_t j = 0; j < run; j++) {
+                buf = bcache_evict();
+                if (!buf) {
+                    break;
+                }
+                memcpy(buf->data, run_dst + j * BCACHE_BLOCK_SIZE, BCACHE_BLOCK_SIZE);
+                bcache_assign(buf, device, lba + i + j);
+            }
+        }
+
+        i += run;
+    }
+
+    return true;
+}
+
+// Write straight to the device, then bring any cached copies up to date
+static bool bcache_write_through(uint32_t device, uint32_t lba, uint32_t count, const uint8_t* src) {
+    bcache_stats.device_writes++;
+    if (!bcache_devices[device].write(lba, count, src)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        bcache_buf_t* buf = bcache_lookup(device, lba + i);
+        if (buf) {
+            memcpy(buf->data, src + i * BCACHE_BLOCK_SIZE, BCACHE_BLOCK_SIZE);
+            buf->dirty = false;
+        }
+    }
+    return true;
+}
+
+bool bcache_write(uint32_t device, uint32_t lba, uint32_t count, const void* buffer) {
+    if (!bcache_device_ok(device)) {
+        return false;
+    }
+
+    const uint8_t* src = (const uint8_t*)buffer;
+
+    if (count > bcache_bypass_limit()) {
+        return bcache_write_through(device, lba, count, src);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t* sector = src + i * BCACHE_BLOCK_SIZE;
+        bcache_buf_t* buf = bcache_lookup(device, lba + i);
+        if (buf) {
+            bcache_stats.hits++;
+            lru_touch(buf);
+        } else {
+            bcache_stats.misses++;
+            buf = bcache_evict();
+            if (!buf) {
+                // Nothing to evict; write this sector through
+                bcache_stats.device_writes++;
+                if (!bcache_devices[device].write(lba + i, 1, sector)) {
+                    return false;
+                }
+                continue;
+            }
+            bcache_assign(buf, device, lba + i);
+        }
+
+        memcpy(buf->data, sector, BCACHE_BLOCK_SIZE);
+        buf->dirty = true;
+    }
+
+    return true;
+}
+
+bool bcache_read_direct(uint32_t device, uint32_t lba, uint32_t count, void* buffer) {
+    if (!bcache_device_ok(device)) {
+        return false;
+    }
+
+    // Cached copies that are newer than the device go out first
+    if (!bcache_sync_range(device, lba, count)) {
+        return false;
+    }
+
+    bcache_stats.device_reads++;
+    return bcache_devices[device].read(lba, count, buffer);
+}
+
+bool bcache_write_direct(uint32_t device, uint32_t lba, uint32_t count, const void* buffer) {
+    if (!bcache_device_ok(device)) {
+        return false;
+    }
+
+    return bcache_write_through(device, lba, count, (const uint8_t*)buffer);
+}
+
+bool bcache_prefetch(uint32_t device, uint32_t lba, uint32_t count) {
+    if (!bcache_device_ok(device)) {
+        return false;
+    }
+
+    // Never let readahead take more than the bypass share of the pool
+    if (count > bcache_bypass_limit()) {
+        count = bcache_bypass_limit();
+    }
+
+    uint32_t i = 0;
+    while (i < count) {
+        if (bcache_lookup(device, lba + i)) {
+            i++;
+            continue;
+        }
+
+        uint32_t run = 1;
+        while (i + run < count && run < BCACHE_PREFETCH_MAX && !bcache_lookup(device, lba + i + run)) {
+            run++;
+        }
+
+        bcache_stats.device_reads++;
+        if (!bcache_devices[device].read(lba + i, run, bcache_staging)) {
+            return false;
+        }
+
+        for (uint32_t j = 0; j < run; j++) {
+            bcache_buf_t* buf = bcache_evict();
+            if (!buf) {
+                return true; // Everything is in use; readahead is only a hint
+            }
+            memcpy(buf->data, bcache_staging + j * BCACHE_BLOCK_SIZE, BCACHE_BLOCK_SIZE);
+            bcache_assign(buf, device, lba + i + j);
+            bcache_stats.prefetched++;
+        }
+
+        i += run;
+    }
+
+    return true;
+}
+
+bool bcache_sync(uint32_t device) {
+    if (!bcache_bufs) {
+        return true;
+    }
+
+    bool ok = true;
+    for (uint32_t i = 0; i < bcache_count; i++) {
+        bcache_buf_t* buf = &bcache_bufs[i];
+        if (buf->valid && buf->dirty && buf->device == device) {
+            if (!bcache_writeback(buf)) {
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+// Write back dirty sectors in [lba, lba + count) only
+bool bcache_sync_range(uint32_t device, uint32_t lba, uint32_t count) {
+    if (!bcache_bufs || !bcache_device_ok(device)) {
+        return true;
+    }
+
+    bool ok = true;
+    if (count > bcache_count) {
+        for (uint32_t i = 0; i < bcache_count; i++) {
+            bcache_buf_t* buf = &bcache_bufs[i];
+            if (buf->valid && buf->dirty && buf->device == device &&
+                buf->lba >= lba && buf->lba - lba < count && !bcache_writeback(buf)) {
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        bcache_buf_t* buf = bcache_lookup(device, lba + i);
+        if (buf && buf->dirty && !bcache_writeback(buf)) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+void bcache_invalidate(uint32_t device) {
+    if (!bcache_bufs) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < bcache_count; i++) {
+        bcache_buf_t* buf = &bcache_bufs[i];
+        if (buf->valid && buf->device == device && buf->refcount == 0) {
+            bcache_hash_remove(buf);
+            buf->valid = false;
+            buf->dirty = false;
+            lru_remove(buf);
+            lru_push_back(buf);
+        }
+    }
+}
+
+void bcache_get_stats(bcache_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+
+    *stats = bcache_stats;
+    stats->buffers = bcache_count;
+    stats->valid = 0;
+    stats->dirty = 0;
+    for (uint32_t i = 0; i < bcache_count; i++) {
+        if (bcache_bufs[i].valid) {
+            stats->valid++;
+            if (bcache_bufs[i].dirty) {
+                stats->dirty++;
+            }
+        }
+    }
+}
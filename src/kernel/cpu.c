@@ -0,0 +1,117 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "../include/cpu.h"
+
+// CPU feature detection
+//
+// CPUID is read once at boot and the interesting words are kept here, so
+// the VMM, the memory routines and "system info" all agree on what the
+// processor can do.
+
+#define EFLAGS_ID          0x200000
+
+#define CR0_MP             (1 << 1)
+#define CR0_EM             (1 << 2)
+#define CR0_TS             (1 << 3)
+#define CR4_OSFXSR         (1 << 9)
+#define CR4_OSXMMEXCPT     (1 << 10)
+
+static bool cpuid_present = false;
+static bool sse_enabled = false;
+static uint32_t max_leaf = 0;
+static uint32_t features_edx = 0;
+static uint32_t features_ecx = 0;
+static uint32_t features7_ebx = 0;
+
+bool cpu_has_cpuid(void) {
+    uint32_t eflags_before, eflags_after;
+
+    // Try to flip the ID bit (bit 21) in EFLAGS
+    asm volatile(
+        "pushfl\n\t"
+        "popl %0\n\t"
+        "movl %0, %1\n\t"
+        "xorl $0x200000, %0\n\t"
+        "pushl %0\n\t"
+        "popfl\n\t"
+        "pushfl\n\t"
+        "popl %0\n\t"
+        "pushl %1\n\t"
+        "popfl"
+        : "=&r" (eflags_after), "=&r" (eflags_before)
+        :
+        : "cc"
+    );
+
+    return ((eflags_before ^ eflags_after) & EFLAGS_ID) != 0;
+}
+
+void cpu_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    asm volatile("cpuid"
+                : "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+                : "a" (leaf), "c" (subleaf));
+}
+
+// FXSAVE-capable SSE needs CR4.OSFXSR, and the FPU must not be emulated
+static void cpu_enable_sse(void) {
+    uint32_t cr0, cr4;
+
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    cr0 &= ~(CR0_EM | CR0_TS);
+    cr0 |= CR0_MP;
+    asm volatile("mov %0, %%cr0" : : "r"(cr0));
+
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+    asm volatile("mov %0, %%cr4" : : "r"(cr4));
+
+    asm volatile("fninit");
+    sse_enabled = true;
+}
+
+void cpu_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid_present = cpu_has_cpuid();
+    if (!cpuid_present) {
+        return;
+    }
+
+    cpu_cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+    max_leaf = eax;
+
+    if (max_leaf >= 1) {
+        cpu_cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+        features_edx = edx;
+        features_ecx = ecx;
+    }
+
+    if (max_leaf >= 7) {
+        cpu_cpuid(7, 0, &eax, &ebx, &ecx, &edx);
+        features7_ebx = ebx;
+    }
+
+    if ((features_edx & CPU_FEATURE_FXSR) && (features_edx & CPU_FEATURE_SSE2)) {
+        cpu_enable_sse();
+    }
+}
+
+uint32_t cpu_get_max_leaf(void) {
+    return max_leaf;
+}
+
+uint32_t cpu_get_features_edx(void) {
+    return features_edx;
+}
+
+uint32_t cpu_get_features_ecx(void) {
+    return features_ecx;
+}
+
+uint32_t cpu_get_features7_ebx(void) {
+    return features7_ebx;
+}
+
+bool cpu_sse_enabled(void) {
+    return sse_enabled;
+}
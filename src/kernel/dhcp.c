@@ -4,6 +4,7 @@
 #include "../include/dhcp.h"
 #include "../include/network.h"
 #include "../include/rtl8139.h"
+#include "../include/slab.h"
 #include "../include/string.h"
 
 // Forward declarations for network functions we need
@@ -32,6 +33,7 @@ static uint32_t dhcp_offered_ip = 0;
 static uint32_t dhcp_lease_time = 0;
 static uint32_t dhcp_timer = 0;
 static bool dhcp_active = false;
+static slab_cache_t* dhcp_packet_cache = NULL;
 static uint32_t dhcp_subnet_mask = 0;
 static uint32_t dhcp_router = 0;
 static uint32_t dhcp_dns_server = 0;
@@ -170,20 +172,23 @@ static bool dhcp_send_packet(const dhcp_packet_t* packet) {
     
     terminal_writestring("DHCP: Building packet...\n");
     
-    // Use static buffer - no dynamic allocation
-    static uint8_t frame[1600];
-    
     // Calculate sizes
     uint16_t dhcp_len = sizeof(dhcp_packet_t);
     uint16_t udp_len = sizeof(udp_header_t) + dhcp_len;
     uint16_t ip_len = sizeof(ip_header_t) + udp_len;
     uint16_t total_len = 14 + ip_len;
     
-    if (total_len > sizeof(frame)) {
+    if (total_len > NETWORK_FRAME_SIZE) {
         terminal_writestring("DHCP: Packet too large\n");
         return false;
     }
     
+    uint8_t* frame = network_alloc_frame();
+    if (!frame) {
+        terminal_writestring("DHCP: Out of frame buffers\n");
+        return false;
+    }
+    
     // Clear the frame
     for (uint16_t i = 0; i < total_len; i++) {
         frame[i] = 0;
@@ -229,6 +234,7 @@ static bool dhcp_send_packet(const dhcp_packet_t* packet) {
     terminal_writestring("DHCP: Sending packet...\n");
     
     bool result = rtl8139_send_packet(frame, total_len);
+    network_free_frame(frame);
     
     if (result) {
         terminal_writestring("DHCP: Packet sent successfully\n");
@@ -239,6 +245,23 @@ static bool dhcp_send_packet(const dhcp_packet_t* packet) {
     return result;
 }
 
+// Build and send one DHCP message using a packet from the packet cache
+static bool dhcp_send_message(uint8_t message_type) {
+    if (!dhcp_packet_cache) {
+        dhcp_packet_cache = slab_cache_create("dhcp_packet", sizeof(dhcp_packet_t), 0, NULL);
+    }
+    
+    dhcp_packet_t* packet = (dhcp_packet_t*)slab_alloc(dhcp_packet_cache);
+    if (!packet) {
+        return false;
+    }
+    
+    dhcp_create_packet(packet, message_type);
+    bool result = dhcp_send_packet(packet);
+    slab_free(dhcp_packet_cache, packet);
+    return result;
+}
+
 // Parse DHCP options
 static void dhcp_parse_options(const uint8_t* options, uint16_t length, 
                               uint8_t* message_type, uint32_t* server_ip,
@@ -339,9 +362,7 @@ void dhcp_process_packet(const uint8_t* packet, uint16_t length) {
                 
                 // Send REQUEST
                 dhcp_state = DHCP_STATE_REQUESTING;
-                dhcp_packet_t request_packet;
-                dhcp_create_packet(&request_packet, DHCP_REQUEST);
-                dhcp_send_packet(&request_packet);
+                dhcp_send_message(DHCP_REQUEST);
                 
                 terminal_writestring("DHCP: Sent REQUEST for offered IP\n");
                 dhcp_timer = 0;
@@ -476,9 +497,7 @@ void dhcp_stop(void) {
     
     // Send RELEASE if we have a lease
     if (dhcp_state == DHCP_STATE_BOUND && dhcp_server_ip != 0) {
-        dhcp_packet_t release_packet;
-        dhcp_create_packet(&release_packet, DHCP_RELEASE);
-        dhcp_send_packet(&release_packet);
+        dhcp_send_message(DHCP_RELEASE);
         terminal_writestring("DHCP: Sent RELEASE to server\n");
     }
     
@@ -513,9 +532,7 @@ void dhcp_tick(void) {
             dhcp_timer = 0;
             
             // Send DISCOVER
-            dhcp_packet_t discover_packet;
-            dhcp_create_packet(&discover_packet, DHCP_DISCOVER);
-            if (dhcp_send_packet(&discover_packet)) {
+            if (dhcp_send_message(DHCP_DISCOVER)) {
                 terminal_writestring("DHCP: DISCOVER sent successfully\n");
             } else {
                 terminal_writestring("DHCP: Failed to send DISCOVER\n");
@@ -582,18 +599,14 @@ void dhcp_tick(void) {
                 dhcp_timer = 0;
                 
                 // Send REQUEST for renewal
-                dhcp_packet_t request_packet;
-                dhcp_create_packet(&request_packet, DHCP_REQUEST);
-                dhcp_send_packet(&request_packet);
+                dhcp_send_message(DHCP_REQUEST);
             }
             break;
             
         case DHCP_STATE_RENEWING:
             // Try to renew every 5 seconds, give up after 25% more of lease time
             if (dhcp_timer % 5 == 0) {
-                dhcp_packet_t request_packet;
-                dhcp_create_packet(&request_packet, DHCP_REQUEST);
-                dhcp_send_packet(&request_packet);
+                dhcp_send_message(DHCP_REQUEST);
             }
             
             if (dhcp_lease_time > 0 && dhcp_timer >= dhcp_lease_time / 4) {
@@ -606,9 +619,7 @@ void dhcp_tick(void) {
         case DHCP_STATE_REBINDING:
             // Try to rebind every 5 seconds, give up after remaining lease time
             if (dhcp_timer % 5 == 0) {
-                dhcp_packet_t request_packet;
-                dhcp_create_packet(&request_packet, DHCP_REQUEST);
-                dhcp_send_packet(&request_packet);
+                dhcp_send_message(DHCP_REQUEST);
             }
             
             if (dhcp_lease_time > 0 && dhcp_timer >= dhcp_lease_time / 4) {
@@ -0,0 +1,148 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/dma.h"
+#include "../include/pmm.h"
+#include "../include/vmm.h"
+#include "../include/string.h"
+
+extern void terminal_writestring(const char* data);
+
+// DMA buffer allocator
+//
+// Buffers are whole frames. A buffer of n frames is placed on a boundary of
+// the next power of two >= n, so it always sits inside one naturally aligned
+// block of at most 64KB and can never straddle a 64KB line.
+//
+// Requests limited to the first 16MB are served from a small zone reserved
+// at boot, so the heap cannot use up ISA-reachable memory first.
+
+#define DMA_ZONE_FRAMES 64      // 256KB low zone
+#define DMA_ZONE_WORDS  (DMA_ZONE_FRAMES / 32)
+
+static uint32_t dma_zone_base = 0;
+static uint32_t dma_zone_map[DMA_ZONE_WORDS];   // One bit per frame, set = used
+
+static void dma_release(uint32_t addr, uint32_t count);
+
+static inline bool zone_test(uint32_t frame) {
+    return (dma_zone_map[frame >> 5] & (1u << (frame & 31))) != 0;
+}
+
+static inline void zone_set(uint32_t frame, bool used) {
+    if (used) {
+        dma_zone_map[frame >> 5] |= 1u << (frame & 31);
+    } else {
+        dma_zone_map[frame >> 5] &= ~(1u << (frame & 31));
+    }
+}
+
+void dma_init(void) {
+    memset(dma_zone_map, 0, sizeof(dma_zone_map));
+
+    // Align the zone to 64KB so zone-relative alignment equals physical alignment
+    dma_zone_base = pmm_alloc_frames(DMA_ZONE_FRAMES, DMA_MAX_SIZE / PMM_FRAME_SIZE, DMA_ISA_LIMIT);
+    if (!dma_zone_base) {
+        terminal_writestring("DMA: No memory below 16MB for the DMA zone\n");
+    }
+}
+
+static uint32_t dma_zone_alloc(uint32_t count, uint32_t align_frames) {
+    if (!dma_zone_base) {
+        return 0;
+    }
+
+    for (uint32_t frame = 0; frame + count <= DMA_ZONE_FRAMES; frame += align_frames) {
+        uint32_t i;
+        for (i = 0; i < count; i++) {
+            if (zone_test(frame + i)) {
+                break;
+            }
+        }
+        if (i == count) {
+            for (i = 0; i < count; i++) {
+                zone_set(frame + i, true);
+            }
+            return dma_zone_base + frame * PMM_FRAME_SIZE;
+        }
+    }
+
+    return 0;
+}
+
+void* dma_alloc(size_t size, uint32_t align, uint32_t flags, uint32_t* phys) {
+    if (size == 0 || size > DMA_MAX_SIZE || (align & (align - 1))) {
+        return NULL;
+    }
+    if (align > DMA_MAX_SIZE) {
+        return NULL;
+    }
+
+    uint32_t count = (size + PMM_FRAME_SIZE - 1) / PMM_FRAME_SIZE;
+
+    uint32_t align_frames = 1;
+    while (align_frames < count) {
+        align_frames <<= 1;
+    }
+    if (align / PMM_FRAME_SIZE > align_frames) {
+        align_frames = align / PMM_FRAME_SIZE;
+    }
+
+    uint32_t addr = 0;
+    if (flags & DMA_BELOW_16MB) {
+        addr = dma_zone_alloc(count, align_frames);
+        if (!addr) {
+            addr = pmm_alloc_frames(count, align_frames, DMA_ISA_LIMIT);
+        }
+    } else {
+        addr = pmm_alloc_frames(count, align_frames, 0);
+    }
+
+    if (!addr) {
+        return NULL;
+    }
+
+    if (!vmm_map(addr, addr, count, VMM_PAGE_WRITE)) {
+        dma_release(addr, count);
+        return NULL;
+    }
+
+    void* buffer = (void*)addr; // Identity mapped
+    if (flags & DMA_ZERO) {
+        memset(buffer, 0, count * PMM_FRAME_SIZE);
+    }
+    if (phys) {
+        *phys = addr;
+    }
+    return buffer;
+}
+
+void dma_free(void* buffer, size_t size) {
+    if (!buffer || size == 0) {
+        return;
+    }
+
+    uint32_t addr = virt_to_phys(buffer);
+    uint32_t count = (size + PMM_FRAME_SIZE - 1) / PMM_FRAME_SIZE;
+
+    vmm_unmap((uint32_t)buffer, count);
+    dma_release(addr, count);
+}
+
+// Return frames to the zone or the PMM
+static void dma_release(uint32_t addr, uint32_t count) {
+    if (dma_zone_base && addr >= dma_zone_base &&
+        addr < dma_zone_base + DMA_ZONE_FRAMES * PMM_FRAME_SIZE) {
+        uint32_t first = (addr - dma_zone_base) / PMM_FRAME_SIZE;
+        for (uint32_t i = 0; i < count && first + i < DMA_ZONE_FRAMES; i++) {
+            zone_set(first + i, false);
+        }
+        return;
+    }
+
+    pmm_free_frames(addr, count);
+}
+
+uint32_t virt_to_phys(const void* virt) {
+    return vmm_get_physical((uint32_t)virt);
+}
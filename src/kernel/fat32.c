@@ -2,6 +2,8 @@
 #include <stddef.h>
 #include <stdint.h>
 #include "../include/string.h"
+#include "../include/memory.h"
+#include "../include/ramdisk.h"
 
 // External function declarations
 extern void terminal_writestring(const char* data);
@@ -11,7 +13,6 @@ extern void terminal_writestring(const char* data);
 #define FAT32_FSINFO_SIGNATURE1 0x41615252
 #define FAT32_FSINFO_SIGNATURE2 0x61417272
 #define FAT32_FSINFO_SIGNATURE3 0xAA550000
-#define RAMDISK_SIZE (16 * 1024 * 1024) // 16MB
 
 typedef struct {
     uint8_t jmp_boot[3];
@@ -81,24 +82,120 @@ typedef struct {
 extern const iso_file_data_t iso_files_data[];
 extern const int iso_files_count;
 
-// Static variables
-static bool ramdisk_initialized = false;
-static uint8_t ramdisk[RAMDISK_SIZE];
+// Layout of the RAM disk filesystem
+#define FAT32_RESERVED_SECTORS    32
+#define FAT32_SECTORS_PER_CLUSTER 8
+#define FAT32_NUM_FATS            2
+#define FAT32_ROOT_CLUSTER        2
+#define FAT32_CLUSTER_SIZE        (FAT32_SECTORS_PER_CLUSTER * 512)
+#define FAT32_ENTRIES_PER_SECTOR  (512 / sizeof(uint32_t))
+#define FAT32_END_OF_CHAIN        0x0FFFFFFF
 
-static bool init_ramdisk(void) {
-    if (ramdisk_initialized) {
+// Formatter state. FAT entries are produced in ascending cluster order, so
+// one sector of FAT is staged at a time and written to every copy.
+static uint32_t format_fat_start;
+static uint32_t format_fat_size;
+static uint32_t format_data_start;
+static uint32_t format_fat_buffer[FAT32_ENTRIES_PER_SECTOR];
+static uint32_t format_fat_sector = 0xFFFFFFFF;
+static uint8_t format_sector[512];
+
+static bool format_fat_flush(void) {
+    if (format_fat_sector == 0xFFFFFFFF) {
         return true;
     }
-    
-    terminal_writestring("FAT32: Initializing RAM disk...\n");
-    
-    // Clear RAM disk
-    for (size_t i = 0; i < sizeof(ramdisk); i++) {
-        ramdisk[i] = 0;
+    for (uint32_t fat = 0; fat < FAT32_NUM_FATS; fat++) {
+        uint32_t sector = format_fat_start + fat * format_fat_size + format_fat_sector;
+        if (!ramdisk_write_sectors(sector, 1, format_fat_buffer)) {
+            return false;
+        }
     }
-    
-    // Create a minimal FAT32 boot sector
-    fat32_boot_sector_t* boot = (fat32_boot_sector_t*)ramdisk;
+    return true;
+}
+
+static bool format_fat_set(uint32_t cluster, uint32_t value) {
+    uint32_t sector = cluster / FAT32_ENTRIES_PER_SECTOR;
+    if (sector != format_fat_sector) {
+        if (!format_fat_flush()) {
+            return false;
+        }
+        memset(format_fat_buffer, 0, sizeof(format_fat_buffer));
+        format_fat_sector = sector;
+    }
+    format_fat_buffer[cluster % FAT32_ENTRIES_PER_SECTOR] = value;
+    return true;
+}
+
+static uint32_t format_cluster_sector(uint32_t cluster) {
+    return format_data_start + (cluster - 2) * FAT32_SECTORS_PER_CLUSTER;
+}
+
+// Write 'size' bytes at 'sector', zero padding the last sector
+static bool format_write(uint32_t sector, const void* data, uint32_t size) {
+    uint32_t full = size / 512;
+    if (full > 0 && !ramdisk_write_sectors(sector, full, data)) {
+        return false;
+    }
+
+    uint32_t tail = size % 512;
+    if (tail) {
+        memset(format_sector, 0, sizeof(format_sector));
+        memcpy(format_sector, (const uint8_t*)data + full * 512, tail);
+        return ramdisk_write_sectors(sector + full, 1, format_sector);
+    }
+    return true;
+}
+
+// Store a file in consecutive clusters starting at *next_cluster
+static bool format_add_file(fat32_dir_entry_t* entry, const char* fat32_name,
+                            const void* content, uint32_t size, uint32_t* next_cluster,
+                            uint32_t total_clusters) {
+    uint32_t clusters = (size + FAT32_CLUSTER_SIZE - 1) / FAT32_CLUSTER_SIZE;
+    if (*next_cluster + clusters > total_clusters + 2) {
+        return false; // Does not fit
+    }
+
+    memcpy(entry->name, fat32_name, 11);
+    entry->attributes = ATTR_ARCHIVE;
+    entry->file_size = size;
+
+    if (clusters == 0) {
+        return true;
+    }
+
+    uint32_t first = *next_cluster;
+    entry->first_cluster_low = first & 0xFFFF;
+    entry->first_cluster_high = first >> 16;
+
+    for (uint32_t i = 0; i < clusters; i++) {
+        uint32_t value = (i + 1 < clusters) ? first + i + 1 : FAT32_END_OF_CHAIN;
+        if (!format_fat_set(first + i, value)) {
+            return false;
+        }
+    }
+
+    *next_cluster = first + clusters;
+    return format_write(format_cluster_sector(first), content, size);
+}
+
+// Lay down a FAT32 filesystem on the RAM disk and load the generated files.
+// Only the sectors written here become resident.
+static bool fat32_format_ramdisk(uint32_t total_sectors) {
+    // Size the FAT for the largest cluster count this disk could have
+    uint32_t max_clusters = (total_sectors - FAT32_RESERVED_SECTORS) / FAT32_SECTORS_PER_CLUSTER;
+    format_fat_size = ((max_clusters + 2) * sizeof(uint32_t) + 511) / 512;
+    format_fat_start = FAT32_RESERVED_SECTORS;
+    format_data_start = format_fat_start + FAT32_NUM_FATS * format_fat_size;
+    format_fat_sector = 0xFFFFFFFF;
+
+    if (format_data_start + FAT32_SECTORS_PER_CLUSTER > total_sectors) {
+        return false;
+    }
+    uint32_t total_clusters = (total_sectors - format_data_start) / FAT32_SECTORS_PER_CLUSTER;
+
+    // Boot sector and its backup
+    memset(format_sector, 0, sizeof(format_sector));
+    fat32_boot_sector_t* boot = (fat32_boot_sector_t*)format_sector;
     
     // Jump instruction
     boot->jmp_boot[0] = 0xEB;
@@ -110,9 +207,9 @@ static bool init_ramdisk(void) {
     
     // BPB
     boot->bytes_per_sector = 512;
-    boot->sectors_per_cluster = 8;
-    boot->reserved_sectors = 32;
-    boot->num_fats = 2;
+    boot->sectors_per_cluster = FAT32_SECTORS_PER_CLUSTER;
+    boot->reserved_sectors = FAT32_RESERVED_SECTORS;
+    boot->num_fats = FAT32_NUM_FATS;
     boot->root_entries = 0;
     boot->total_sectors_16 = 0;
     boot->media_type = 0xF8;
@@ -120,13 +217,13 @@ static bool init_ramdisk(void) {
     boot->sectors_per_track = 63;
     boot->num_heads = 255;
     boot->hidden_sectors = 0;
-    boot->total_sectors_32 = sizeof(ramdisk) / 512;
+    boot->total_sectors_32 = total_sectors;
     
     // FAT32 specific
-    boot->fat_size_32 = 128; // 128 sectors for FAT
+    boot->fat_size_32 = format_fat_size;
     boot->ext_flags = 0;
     boot->fs_version = 0;
-    boot->root_cluster = 2;
+    boot->root_cluster = FAT32_ROOT_CLUSTER;
     boot->fs_info = 1;
     boot->backup_boot_sector = 6;
     boot->drive_number = 0x80;
@@ -135,58 +232,41 @@ static bool init_ramdisk(void) {
     memcpy(boot->volume_label, "SYNCWIDEOS ", 11);
     memcpy(boot->fs_type, "FAT32   ", 8);
     boot->signature = 0xAA55;
-    
-    // Create FSInfo sector
-    fat32_fsinfo_t* fsinfo = (fat32_fsinfo_t*)(ramdisk + 512);
-    fsinfo->lead_signature = FAT32_FSINFO_SIGNATURE1;
-    fsinfo->struct_signature = FAT32_FSINFO_SIGNATURE2;
-    fsinfo->free_count = 0xFFFFFFFF; // Unknown
-    fsinfo->next_free = 3;
-    fsinfo->trail_signature = FAT32_FSINFO_SIGNATURE3;
-    
-    // Initialize FAT (mark first few clusters as used)
-    uint32_t* fat = (uint32_t*)(ramdisk + 32 * 512); // FAT starts at sector 32
-    fat[0] = 0x0FFFFFF8; // Media descriptor
-    fat[1] = 0x0FFFFFFF; // End of chain
-    fat[2] = 0x0FFFFFFF; // Root directory (end of chain)
-    
-    // Get root directory location
-    uint32_t root_sector = 32 + (2 * 128); // After FATs
-    uint32_t root_cluster_sector = root_sector + (2 - 2) * 8; // Cluster 2
-    fat32_dir_entry_t* root_entries = (fat32_dir_entry_t*)(ramdisk + root_cluster_sector * 512);
+
+    if (!ramdisk_write_sectors(0, 1, format_sector) ||
+        !ramdisk_write_sectors(boot->backup_boot_sector, 1, format_sector)) {
+        return false;
+    }
+
+    // Reserved entries and the root directory
+    format_fat_set(0, 0x0FFFFFF8); // Media descriptor
+    format_fat_set(1, FAT32_END_OF_CHAIN);
+    format_fat_set(FAT32_ROOT_CLUSTER, FAT32_END_OF_CHAIN);
+
+    fat32_dir_entry_t* root_entries = (fat32_dir_entry_t*)calloc(1, FAT32_CLUSTER_SIZE);
+    if (!root_entries) {
+        return false;
+    }
+    uint32_t max_entries = FAT32_CLUSTER_SIZE / sizeof(fat32_dir_entry_t);
+    uint32_t next_cluster = FAT32_ROOT_CLUSTER + 1;
+    bool ok = true;
     
     // Load files from generated data
     if (iso_files_count > 0) {
         terminal_writestring("FAT32: Loading files from iso_files data...\n");
         
-        uint32_t next_cluster = 3;
-        int files_added = 0;
+        uint32_t files_added = 0;
         
-        for (int i = 0; i < iso_files_count && files_added < 16; i++) {
+        for (int i = 0; i < iso_files_count && files_added < max_entries; i++) {
             const iso_file_data_t* file_data = &iso_files_data[i];
             
-            // Create directory entry
-            memcpy(root_entries[files_added].name, file_data->fat32_name, 11);
-            root_entries[files_added].attributes = ATTR_ARCHIVE;
-            root_entries[files_added].first_cluster_low = next_cluster;
-            root_entries[files_added].first_cluster_high = 0;
-            root_entries[files_added].file_size = file_data->size;
-            
-            // Mark cluster as end of chain
-            fat[next_cluster] = 0x0FFFFFFF;
-            
-            // Write file content
-            uint32_t file_sector = root_sector + (next_cluster - 2) * 8;
-            char* file_content = (char*)(ramdisk + file_sector * 512);
-            
-            // Copy content (limit to cluster size)
-            size_t max_size = 8 * 512; // 8 sectors per cluster
-            size_t copy_size = file_data->size > max_size ? max_size : file_data->size;
-            memcpy(file_content, file_data->content, copy_size);
-            
-            // Update file size if truncated
-            if (copy_size < file_data->size) {
-                root_entries[files_added].file_size = copy_size;
+            if (!format_add_file(&root_entries[files_added], file_data->fat32_name,
+                                 file_data->content, file_data->size, &next_cluster, total_clusters)) {
+                terminal_writestring("FAT32: No room for file: ");
+                terminal_writestring(file_data->filename);
+                terminal_writestring("\n");
+                memset(&root_entries[files_added], 0, sizeof(fat32_dir_entry_t));
+                continue;
             }
             
             // Debug output
@@ -195,7 +275,6 @@ static bool init_ramdisk(void) {
             terminal_writestring("\n");
             
             files_added++;
-            next_cluster++;
         }
         
         terminal_writestring("FAT32: Successfully loaded files\n");
@@ -203,21 +282,55 @@ static bool init_ramdisk(void) {
         terminal_writestring("FAT32: No files found, creating default test file\n");
         
         // Fallback: create default test file
-        memcpy(root_entries[0].name, "TEST    TXT", 11);
-        root_entries[0].attributes = ATTR_ARCHIVE;
-        root_entries[0].first_cluster_low = 3;
-        root_entries[0].first_cluster_high = 0;
-        root_entries[0].file_size = 30;
-        
-        fat[3] = 0x0FFFFFFF;
-        
-        uint32_t test_file_sector = root_sector + (3 - 2) * 8;
-        char* test_content = (char*)(ramdisk + test_file_sector * 512);
-        memcpy(test_content, "Hello from FAT32 filesystem!\n", 30);
+        static const char test_content[] = "Hello from FAT32 filesystem!\n";
+        ok = format_add_file(&root_entries[0], "TEST    TXT", test_content,
+                             sizeof(test_content) - 1, &next_cluster, total_clusters);
     }
+
+    ok = ok && ramdisk_write_sectors(format_cluster_sector(FAT32_ROOT_CLUSTER),
+                                     FAT32_SECTORS_PER_CLUSTER, root_entries);
+    free(root_entries);
+    ok = ok && format_fat_flush();
+    if (!ok) {
+        return false;
+    }
+    
+    // FSInfo with an exact free count and next free hint
+    memset(format_sector, 0, sizeof(format_sector));
+    fat32_fsinfo_t* fsinfo = (fat32_fsinfo_t*)format_sector;
+    fsinfo->lead_signature = FAT32_FSINFO_SIGNATURE1;
+    fsinfo->struct_signature = FAT32_FSINFO_SIGNATURE2;
+    fsinfo->free_count = total_clusters + 2 - next_cluster;
+    fsinfo->next_free = next_cluster;
+    fsinfo->trail_signature = FAT32_FSINFO_SIGNATURE3;
     
-    ramdisk_initialized = true;
-    terminal_writestring("FAT32: RAM disk initialized\n");
+    return ramdisk_write_sectors(1, 1, format_sector);
+}
+
+static bool init_ramdisk(void) {
+    if (ramdisk_is_ready()) {
+        return true;
+    }
+    
+    terminal_writestring("FAT32: Initializing RAM disk...\n");
+    
+    uint32_t sectors = ramdisk_pick_size();
+    if (!ramdisk_create(sectors)) {
+        terminal_writestring("FAT32: Not enough memory for the RAM disk\n");
+        return false;
+    }
+    
+    if (!fat32_format_ramdisk(sectors)) {
+        terminal_writestring("FAT32: Failed to format RAM disk\n");
+        ramdisk_destroy();
+        return false;
+    }
+    
+    char buffer[16];
+    terminal_writestring("FAT32: RAM disk initialized (");
+    itoa(sectors / 2048, buffer, 10);
+    terminal_writestring(buffer);
+    terminal_writestring(" MB)\n");
     return true;
 }
 
@@ -228,10 +341,8 @@ bool fat32_init(void) {
 
 // Public function to mount FAT32
 bool fat32_mount(void) {
-    if (!ramdisk_initialized) {
-        if (!init_ramdisk()) {
-            return false;
-        }
+    if (!init_ramdisk()) {
+        return false;
     }
     
     terminal_writestring("FAT32: Filesystem mounted\n");
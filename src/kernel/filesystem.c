@@ -3,6 +3,12 @@
 #include "../include/disk.h"
 #include "../include/vga.h"
 #include "../include/memory.h"
+#include "../include/slab.h"
+#include "../include/fat32.h"
+#include "../include/ramdisk.h"
+#include "../include/bcache.h"
+#include "../include/cpu.h"
+#include "../include/fsqueue.h"
 
 // Storage device interface
 extern void terminal_writestring(const char* data);
@@ -12,13 +18,15 @@ extern void memory_init(void);
 
 // Global filesystem state
 static fat32_fs_t g_fs;
-static fs_file_handle_t g_file_handles[32];
-static uint8_t g_cluster_buffer[SECTOR_SIZE * 8];
+static slab_cache_t* g_handle_cache = NULL;
+static fs_file_handle_t* g_open_handles = NULL;
+static uint8_t g_dir_buffer[SECTOR_SIZE * 8];  // Directory operations only
 static fs_cwd_t g_cwd;
+static bool g_cache_ready = false;
 
-// Simple RAM disk for testing
-static uint8_t ramdisk[1024 * 1024 * 4]; // 4MB RAM disk
-static bool ramdisk_initialized = false;
+static void dcache_reset(void);
+static void dir_index_reset(void);
+static bool fs_resolve_dir(const char* path, uint32_t* dir_out);
 
 // Helper function to convert cluster to sectors
 static uint32_t cluster_to_sector(uint32_t cluster) {
@@ -26,95 +34,45 @@ static uint32_t cluster_to_sector(uint32_t cluster) {
     return g_fs.data_start_sector + (cluster - 2) * g_fs.sectors_per_cluster;
 }
 
-// Storage interface implementation for RAM disk
-bool storage_read_sectors(uint32_t sector, uint32_t count, void* buffer) {
-    if (!ramdisk_initialized) {
-        // Initialize simple RAM disk on first access
-        for (size_t i = 0; i < sizeof(ramdisk); i++) {
-            ramdisk[i] = 0;
-        }
-        
-        // Create minimal FAT32 boot sector
-        fat32_boot_sector_t* boot = (fat32_boot_sector_t*)ramdisk;
-        boot->bytes_per_sector = 512;
-        boot->sectors_per_cluster = 8;
-        boot->reserved_sectors = 32;
-        boot->num_fats = 2;
-        boot->fat_size_32 = 64;
-        boot->root_cluster = 2;
-        boot->total_sectors_32 = sizeof(ramdisk) / 512;
-        boot->signature = 0xAA55;
-        
-        // Initialize FAT
-        uint32_t* fat = (uint32_t*)(ramdisk + 32 * 512);
-        fat[0] = 0x0FFFFFF8;
-        fat[1] = 0x0FFFFFFF;
-        fat[2] = 0x0FFFFFFF; // Root directory
-        
-        // Create a simple test file in root directory
-        uint32_t root_sector = 32 + (2 * 64); // After FATs
-        uint32_t root_cluster_sector = root_sector + (2 - 2) * 8; // Cluster 2
-        fat32_dir_entry_t* root_entries = (fat32_dir_entry_t*)(ramdisk + root_cluster_sector * 512);
-        
-        // Create test.txt file
-        for (int i = 0; i < 11; i++) {
-            root_entries[0].name[i] = ' ';
-        }
-        root_entries[0].name[0] = 'T';
-        root_entries[0].name[1] = 'E';
-        root_entries[0].name[2] = 'S';
-        root_entries[0].name[3] = 'T';
-        root_entries[0].name[8] = 'T';
-        root_entries[0].name[9] = 'X';
-        root_entries[0].name[10] = 'T';
-        root_entries[0].attributes = ATTR_ARCHIVE;
-        root_entries[0].first_cluster_low = 3;
-        root_entries[0].first_cluster_high = 0;
-        root_entries[0].file_size = 26;
-        
-        // Mark cluster 3 as end of chain
-        fat[3] = 0x0FFFFFFF;
-        
-        // Write test file content
-        uint32_t test_file_sector = root_sector + (3 - 2) * 8;
-        char* test_content = (char*)(ramdisk + test_file_sector * 512);
-        strcpy(test_content, "Hello from FAT32 system!\n");
-        
-        ramdisk_initialized = true;
-        terminal_writestring("FAT32: RAM disk initialized with test file\n");
+// Storage interface implementation for RAM disk. The disk is created and
+// formatted by fat32_init() on first access, and all traffic goes through
+// the buffer cache.
+static bool storage_ready(void) {
+    if (!ramdisk_is_ready() && !fat32_init()) {
+        return false;
     }
     
-    if (sector * 512 + count * 512 > sizeof(ramdisk)) {
+    if (!g_cache_ready) {
+        g_cache_ready = bcache_init(BCACHE_DEFAULT_BUFFERS) &&
+                        bcache_register_device(BCACHE_DEV_RAMDISK, ramdisk_read_sectors, ramdisk_write_sectors);
+    }
+    return g_cache_ready;
+}
+
+bool storage_read_sectors(uint32_t sector, uint32_t count, void* buffer) {
+    if (!storage_ready()) {
         return false;
     }
     
-    uint8_t* src = ramdisk + (sector * 512);
-    uint8_t* dst = (uint8_t*)buffer;
-    
-    for (uint32_t i = 0; i < count * 512; i++) {
-        dst[i] = src[i];
+    return bcache_read(BCACHE_DEV_RAMDISK, sector, count, buffer);
+}
+
+// Read-only view straight into the RAM disk, for sectors that are not
+// sitting dirty in the cache
+static const uint8_t* storage_map_sectors(uint32_t sector, uint32_t* count) {
+    if (!storage_ready() || !bcache_sync_range(BCACHE_DEV_RAMDISK, sector, *count)) {
+        return NULL;
     }
     
-    return true;
+    return (const uint8_t*)ramdisk_map_sectors(sector, count);
 }
 
 bool storage_write_sectors(uint32_t sector, uint32_t count, const void* buffer) {
-    if (!ramdisk_initialized) {
-        storage_read_sectors(0, 1, g_cluster_buffer); // Initialize
-    }
-    
-    if (sector * 512 + count * 512 > sizeof(ramdisk)) {
+    if (!storage_ready()) {
         return false;
     }
     
-    uint8_t* dst = ramdisk + (sector * 512);
-    const uint8_t* src = (const uint8_t*)buffer;
-    
-    for (uint32_t i = 0; i < count * 512; i++) {
-        dst[i] = src[i];
-    }
-    
-    return true;
+    return bcache_write(BCACHE_DEV_RAMDISK, sector, count, buffer);
 }
 
 // Initialize filesystem
@@ -123,8 +81,9 @@ bool fs_init(void) {
     
     // Clear filesystem state
     g_fs.mounted = false;
-    for (int i = 0; i < 32; i++) {
-        g_file_handles[i].in_use = false;
+    g_open_handles = NULL;
+    if (!g_handle_cache) {
+        g_handle_cache = slab_cache_create("fs_handle", sizeof(fs_file_handle_t), 0, NULL);
     }
     
     // Initialize current working directory
@@ -135,6 +94,225 @@ bool fs_init(void) {
     return fs_mount();
 }
 
+// Free cluster map helpers (bit set = cluster is free)
+static inline void free_map_set(uint32_t cluster, bool free) {
+    if (free) {
+        g_fs.free_map[cluster >> 5] |= 1u << (cluster & 31);
+    } else {
+        g_fs.free_map[cluster >> 5] &= ~(1u << (cluster & 31));
+    }
+}
+
+// First free cluster at or after 'start', 0 if there is none
+static uint32_t free_map_find(uint32_t start) {
+    uint32_t word = start >> 5;
+    if (word >= g_fs.free_map_words) {
+        return 0;
+    }
+    
+    uint32_t bits = g_fs.free_map[word] & (0xFFFFFFFFu << (start & 31));
+    while (!bits) {
+        if (++word >= g_fs.free_map_words) {
+            return 0;
+        }
+        bits = g_fs.free_map[word];
+    }
+    return (word << 5) + __builtin_ctz(bits);
+}
+
+static void fat32_release_fat(void) {
+    free(g_fs.fat);
+    free(g_fs.free_map);
+    free(g_fs.fat_dirty);
+    g_fs.fat = NULL;
+    g_fs.free_map = NULL;
+    g_fs.fat_dirty = NULL;
+    g_fs.free_map_ready = false;
+    g_fs.free_map_words = 0;
+    g_fs.fat_sectors = 0;
+    g_fs.fat_dirty_count = 0;
+}
+
+static inline bool fat_sector_dirty(uint32_t sector) {
+    return (g_fs.fat_dirty[sector >> 5] & (1u << (sector & 31))) != 0;
+}
+
+static inline void fat_mark_dirty(uint32_t cluster) {
+    uint32_t sector = cluster * 4 / SECTOR_SIZE;
+    if (!fat_sector_dirty(sector)) {
+        g_fs.fat_dirty[sector >> 5] |= 1u << (sector & 31);
+        g_fs.fat_dirty_count++;
+    }
+}
+
+// Read the first FAT into memory in one request. Clusters past the end of
+// the volume never get a free map bit, so they cannot be handed out.
+static bool fat32_load_fat(void) {
+    uint32_t entries = g_fs.total_clusters + 2;
+    uint32_t sectors = (entries * 4 + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    if (sectors > g_fs.fat_size) {
+        return false;
+    }
+    
+    fat32_release_fat();
+    g_fs.free_map_words = (entries + 31) / 32;
+    g_fs.fat_sectors = sectors;
+    g_fs.fat = (uint32_t*)malloc(sectors * SECTOR_SIZE);
+    g_fs.fat_dirty = (uint32_t*)calloc((sectors + 31) / 32, sizeof(uint32_t));
+    if (!g_fs.fat || !g_fs.fat_dirty) {
+        fat32_release_fat();
+        return false;
+    }
+    
+    if (!storage_read_sectors(g_fs.fat_start_sector, sectors, g_fs.fat)) {
+        fat32_release_fat();
+        return false;
+    }
+    
+    return true;
+}
+
+static inline uint32_t bit_count(uint32_t v) {
+    v = v - ((v >> 1) & 0x55555555);
+    v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+    return (((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+static const uint32_t fat_entry_mask[4] __attribute__((aligned(16))) = {
+    0x0FFFFFFF, 0x0FFFFFFF, 0x0FFFFFFF, 0x0FFFFFFF
+};
+
+// Free map word for 32 FAT entries: bit i is set when fat[i] is free.
+// With SSE2 four entries are masked and compared per instruction.
+static uint32_t fat_free_bits(const uint32_t* fat, bool sse2) {
+    uint32_t bits = 0;
+    
+    if (sse2) {
+        for (int i = 0; i < 32; i += 4) {
+            uint32_t mask;
+            asm volatile(
+                "movdqu (%1), %%xmm0\n\t"
+                "pand %2, %%xmm0\n\t"
+                "pxor %%xmm1, %%xmm1\n\t"
+                "pcmpeqd %%xmm1, %%xmm0\n\t"
+                "movmskps %%xmm0, %0"
+                : "=r"(mask)
+                : "r"(fat + i), "m"(fat_entry_mask));
+            bits |= mask << i;
+        }
+        return bits;
+    }
+    
+    for (int i = 0; i < 32; i++) {
+        bits |= (uint32_t)((fat[i] & 0x0FFFFFFF) == FAT32_FREE) << i;
+    }
+    return bits;
+}
+
+// Build the free map from the in-memory FAT in one pass, a map word at a
+// time, and take the exact free count from it
+static bool fat32_build_free_map(void) {
+    g_fs.free_map = (uint32_t*)calloc(g_fs.free_map_words, sizeof(uint32_t));
+    if (!g_fs.free_map) {
+        return false;
+    }
+    
+    bool sse2 = cpu_sse_enabled() && (cpu_get_features_edx() & CPU_FEATURE_SSE2);
+    uint32_t entries = g_fs.total_clusters + 2;
+    uint32_t full_words = entries / 32;
+    uint32_t free_count = 0;
+    
+    for (uint32_t word = 0; word < full_words; word++) {
+        uint32_t bits = fat_free_bits(g_fs.fat + word * 32, sse2);
+        g_fs.free_map[word] = bits;
+        free_count += bit_count(bits);
+    }
+    for (uint32_t cluster = full_words * 32; cluster < entries; cluster++) {
+        if ((g_fs.fat[cluster] & 0x0FFFFFFF) == FAT32_FREE) {
+            free_map_set(cluster, true);
+            free_count++;
+        }
+    }
+    
+    // Entries 0 and 1 are reserved, whatever they hold
+    for (uint32_t cluster = 0; cluster < 2; cluster++) {
+        if (g_fs.free_map[0] & (1u << cluster)) {
+            free_map_set(cluster, false);
+            free_count--;
+        }
+    }
+    
+    g_fs.free_clusters = free_count;
+    g_fs.free_map_ready = true;
+    return true;
+}
+
+// Allocation needs the free map; it is built on first use after a mount
+// that trusted FSInfo
+static bool fat32_free_map_ready(void) {
+    return g_fs.free_map_ready || fat32_build_free_map();
+}
+
+// FSInfo
+//
+// The FSInfo sector records the free cluster count and where to start
+// looking for a free cluster. When it is valid, mount takes both from it
+// and does not scan the FAT. It is brought up to date on fs_sync() and at
+// unmount.
+
+static bool fsinfo_valid(const fat32_fsinfo_t* fsinfo) {
+    return fsinfo->lead_signature == FAT32_FSINFO_SIGNATURE1 &&
+           fsinfo->struct_signature == FAT32_FSINFO_SIGNATURE2 &&
+           fsinfo->trail_signature == FAT32_FSINFO_SIGNATURE3;
+}
+
+static bool fat32_read_fsinfo(void) {
+    uint16_t sector = g_fs.boot_sector.fs_info;
+    g_fs.fsinfo_sector = 0;
+    if (sector == 0 || sector == 0xFFFF || sector >= g_fs.fat_start_sector) {
+        return false;
+    }
+    
+    fat32_fsinfo_t fsinfo;
+    if (!storage_read_sectors(sector, 1, &fsinfo) || !fsinfo_valid(&fsinfo)) {
+        return false;
+    }
+    g_fs.fsinfo_sector = sector;
+    
+    // A count of 0xFFFFFFFF means unknown
+    if (fsinfo.free_count > g_fs.total_clusters) {
+        return false;
+    }
+    
+    g_fs.free_clusters = fsinfo.free_count;
+    g_fs.next_free_cluster = fsinfo.next_free;
+    if (g_fs.next_free_cluster < 2 || g_fs.next_free_cluster >= g_fs.total_clusters + 2) {
+        g_fs.next_free_cluster = 2;
+    }
+    return true;
+}
+
+static bool fat32_write_fsinfo(void) {
+    if (g_fs.fsinfo_sector == 0) {
+        return true;
+    }
+    
+    bcache_buf_t* buf = bcache_get(BCACHE_DEV_RAMDISK, g_fs.fsinfo_sector, true);
+    if (!buf) {
+        return false;
+    }
+    
+    fat32_fsinfo_t* fsinfo = (fat32_fsinfo_t*)buf->data;
+    if (fsinfo_valid(fsinfo) &&
+        (fsinfo->free_count != g_fs.free_clusters || fsinfo->next_free != g_fs.next_free_cluster)) {
+        fsinfo->free_count = g_fs.free_clusters;
+        fsinfo->next_free = g_fs.next_free_cluster;
+        bcache_mark_dirty(buf);
+    }
+    bcache_release(buf);
+    return true;
+}
+
 // Mount FAT32 filesystem
 bool fs_mount(void) {
     if (g_fs.mounted) {
@@ -166,17 +344,24 @@ bool fs_mount(void) {
     uint32_t data_sectors = g_fs.boot_sector.total_sectors_32 - g_fs.data_start_sector;
     g_fs.total_clusters = data_sectors / g_fs.sectors_per_cluster;
     
-    // Initialize free cluster tracking
-    g_fs.free_clusters = 0;
-    g_fs.next_free_cluster = 3; // Start searching from cluster 3
-    
-    // Count free clusters
-    for (uint32_t cluster = 2; cluster < g_fs.total_clusters + 2; cluster++) {
-        if (fat32_read_fat_entry(cluster) == FAT32_FREE) {
-            g_fs.free_clusters++;
+    // Load the FAT; the free map waits for the first allocation when
+    // FSInfo can be trusted
+    if (!fat32_load_fat()) {
+        terminal_writestring("FAT32: Failed to load the FAT\n");
+        return false;
+    }
+    if (!fat32_read_fsinfo()) {
+        g_fs.next_free_cluster = 2;
+        if (!fat32_build_free_map()) {
+            terminal_writestring("FAT32: Failed to build the free cluster map\n");
+            fat32_release_fat();
+            return false;
         }
     }
     
+    dcache_reset();
+    dir_index_reset();
+    
     // Set current working directory to root
     g_cwd.cluster = g_fs.root_cluster;
     strcpy(g_cwd.path, "/");
@@ -197,27 +382,64 @@ const char* fs_getcwd(void) {
 
 // Change directory
 bool fs_chdir(const char* path) {
-    if (!g_fs.mounted || !path) {
+    if (!g_fs.mounted || !path || !*path) {
         return false;
     }
     
-    // Handle special cases
-    if (strcmp(path, "/") == 0) {
-        g_cwd.cluster = g_fs.root_cluster;
-        strcpy(g_cwd.path, "/");
-        return true;
+    uint32_t cluster;
+    if (!fs_resolve_dir(path, &cluster)) {
+        return false;
     }
     
-    // For now, only support root directory
-    // TODO: Implement full path resolution
-    if (strcmp(path, "..") == 0 && strcmp(g_cwd.path, "/") != 0) {
-        // Go to parent directory (for now, just root)
-        g_cwd.cluster = g_fs.root_cluster;
-        strcpy(g_cwd.path, "/");
-        return true;
+    // Build the new path text the same way the path was walked
+    char new_path[FS_MAX_PATH_LENGTH];
+    size_t length = 0;
+    if (path[0] != '/') {
+        length = strlen(g_cwd.path);
+        memcpy(new_path, g_cwd.path, length);
+    }
+    if (length == 0 || new_path[length - 1] == '/') {
+        length = length ? length - 1 : 0; // Trailing slash only on "/"
+    }
+    
+    while (*path) {
+        while (*path == '/') {
+            path++;
+        }
+        const char* component = path;
+        while (*path && *path != '/') {
+            path++;
+        }
+        size_t component_length = path - component;
+        
+        if (component_length == 0 || (component_length == 1 && component[0] == '.')) {
+            continue;
+        }
+        if (component_length == 2 && component[0] == '.' && component[1] == '.') {
+            while (length > 0 && new_path[length - 1] != '/') {
+                length--;
+            }
+            if (length > 0) {
+                length--;
+            }
+            continue;
+        }
+        if (length + 1 + component_length >= FS_MAX_PATH_LENGTH) {
+            return false;
+        }
+        new_path[length++] = '/';
+        memcpy(new_path + length, component, component_length);
+        length += component_length;
     }
     
-    return false; // Directory change not supported yet
+    if (length == 0) {
+        new_path[length++] = '/';
+    }
+    new_path[length] = '\0';
+    
+    g_cwd.cluster = cluster;
+    strcpy(g_cwd.path, new_path);
+    return true;
 }
 
 // Read FAT entry
@@ -226,85 +448,201 @@ uint32_t fat32_read_fat_entry(uint32_t cluster) {
         return FAT32_EOC;
     }
     
-    // Calculate FAT sector and offset
-    uint32_t fat_offset = cluster * 4; // 4 bytes per FAT32 entry
-    uint32_t fat_sector = g_fs.fat_start_sector + (fat_offset / SECTOR_SIZE);
-    uint32_t sector_offset = fat_offset % SECTOR_SIZE;
-    
-    // Read FAT sector
-    uint8_t sector_buffer[SECTOR_SIZE];
-    if (!storage_read_sectors(fat_sector, 1, sector_buffer)) {
-        return FAT32_EOC;
-    }
-    
     // Extract FAT entry (mask off upper 4 bits)
-    uint32_t fat_entry = *(uint32_t*)(sector_buffer + sector_offset) & 0x0FFFFFFF;
-    return fat_entry;
+    return g_fs.fat[cluster] & 0x0FFFFFFF;
 }
 
-// Write FAT entry
+// Write FAT entry. Only the in-memory FAT changes here; the sector is
+// marked dirty and reaches the disk on the next fat32_flush_fat().
 bool fat32_write_fat_entry(uint32_t cluster, uint32_t value) {
     if (!g_fs.mounted || cluster < 2 || cluster >= g_fs.total_clusters + 2) {
         return false;
     }
     
-    // Calculate FAT sector and offset
-    uint32_t fat_offset = cluster * 4; // 4 bytes per FAT32 entry
-    uint32_t fat_sector = g_fs.fat_start_sector + (fat_offset / SECTOR_SIZE);
-    uint32_t sector_offset = fat_offset % SECTOR_SIZE;
+    // Update FAT entry (preserve upper 4 bits)
+    uint32_t* fat_entry = &g_fs.fat[cluster];
+    bool was_free = (*fat_entry & 0x0FFFFFFF) == FAT32_FREE;
+    bool now_free = (value & 0x0FFFFFFF) == FAT32_FREE;
+    *fat_entry = (*fat_entry & 0xF0000000) | (value & 0x0FFFFFFF);
+    fat_mark_dirty(cluster);
     
-    // Read FAT sector
-    uint8_t sector_buffer[SECTOR_SIZE];
-    if (!storage_read_sectors(fat_sector, 1, sector_buffer)) {
-        return false;
+    // Keep the free map in step
+    if (was_free != now_free) {
+        if (g_fs.free_map_ready) {
+            free_map_set(cluster, now_free);
+        }
+        if (now_free) {
+            g_fs.free_clusters++;
+        } else {
+            g_fs.free_clusters--;
+        }
     }
     
-    // Update FAT entry (preserve upper 4 bits)
-    uint32_t* fat_entry = (uint32_t*)(sector_buffer + sector_offset);
-    *fat_entry = (*fat_entry & 0xF0000000) | (value & 0x0FFFFFFF);
+    return true;
+}
+
+// Write dirty FAT sectors to disk. Runs of adjacent dirty sectors go out as
+// one request; the primary FAT is written completely before any mirror, so
+// an interrupted flush leaves the backup copies at the previous state.
+bool fat32_flush_fat(void) {
+    if (!g_fs.fat || g_fs.fat_dirty_count == 0) {
+        return true;
+    }
     
-    // Write back to all FAT copies
     for (uint8_t fat_num = 0; fat_num < g_fs.boot_sector.num_fats; fat_num++) {
-        uint32_t current_fat_sector = g_fs.fat_start_sector + (fat_num * g_fs.fat_size) + (fat_offset / SECTOR_SIZE);
-        if (!storage_write_sectors(current_fat_sector, 1, sector_buffer)) {
-            return false;
+        uint32_t base = g_fs.fat_start_sector + fat_num * g_fs.fat_size;
+        uint32_t sector = 0;
+        
+        while (sector < g_fs.fat_sectors) {
+            if (!fat_sector_dirty(sector)) {
+                sector++;
+                continue;
+            }
+            
+            uint32_t run = 1;
+            while (sector + run < g_fs.fat_sectors && fat_sector_dirty(sector + run)) {
+                run++;
+            }
+            
+            const uint8_t* data = (const uint8_t*)g_fs.fat + sector * SECTOR_SIZE;
+            if (!storage_write_sectors(base + sector, run, data)) {
+                return false; // Sectors stay dirty for the next attempt
+            }
+            sector += run;
         }
     }
     
+    memset(g_fs.fat_dirty, 0, ((g_fs.fat_sectors + 31) / 32) * sizeof(uint32_t));
+    g_fs.fat_dirty_count = 0;
     return true;
 }
 
 // Allocate a free cluster
 uint32_t fat32_allocate_cluster(void) {
-    if (!g_fs.mounted || g_fs.free_clusters == 0) {
+    if (!g_fs.mounted || !fat32_free_map_ready() || g_fs.free_clusters == 0) {
         return 0;
     }
     
-    // Search for a free cluster starting from next_free_cluster
-    for (uint32_t cluster = g_fs.next_free_cluster; cluster < g_fs.total_clusters + 2; cluster++) {
-        if (fat32_read_fat_entry(cluster) == FAT32_FREE) {
-            // Mark cluster as end of chain
-            if (fat32_write_fat_entry(cluster, FAT32_EOC)) {
-                g_fs.free_clusters--;
-                g_fs.next_free_cluster = cluster + 1;
-                return cluster;
-            }
+    // Search from the hint, then wrap around to the start
+    uint32_t cluster = free_map_find(g_fs.next_free_cluster);
+    if (!cluster) {
+        cluster = free_map_find(2);
+    }
+    if (!cluster) {
+        return 0; // No free clusters found
+    }
+    
+    // Mark cluster as end of chain
+    if (!fat32_write_fat_entry(cluster, FAT32_EOC)) {
+        return 0;
+    }
+    
+    g_fs.next_free_cluster = cluster + 1;
+    return cluster;
+}
+
+// Number of free clusters starting at 'start', counting no further than max
+static uint32_t free_run_length(uint32_t start, uint32_t max) {
+    uint32_t length = 0;
+    uint32_t cluster = start;
+    
+    while (length < max && (cluster >> 5) < g_fs.free_map_words) {
+        uint32_t bits = g_fs.free_map[cluster >> 5] >> (cluster & 31);
+        uint32_t avail = 32 - (cluster & 31);
+        
+        // Free bits from here to the first used one in this word
+        uint32_t run = (~bits == 0) ? avail : (uint32_t)__builtin_ctz(~bits);
+        if (run > avail) {
+            run = avail;
+        }
+        
+        length += run;
+        if (run < avail) {
+            break;
         }
+        cluster += run;
     }
     
-    // Search from the beginning if we didn't find one
-    for (uint32_t cluster = 2; cluster < g_fs.next_free_cluster; cluster++) {
-        if (fat32_read_fat_entry(cluster) == FAT32_FREE) {
-            // Mark cluster as end of chain
-            if (fat32_write_fat_entry(cluster, FAT32_EOC)) {
-                g_fs.free_clusters--;
-                g_fs.next_free_cluster = cluster + 1;
-                return cluster;
-            }
+    return length < max ? length : max;
+}
+
+// Search [from, to) for a run of 'count' free clusters, remembering the
+// longest shorter run seen
+static uint32_t free_run_search(uint32_t from, uint32_t to, uint32_t count,
+                                uint32_t* best_start, uint32_t* best_length) {
+    uint32_t cluster = from;
+    while (cluster < to) {
+        uint32_t start = free_map_find(cluster);
+        if (!start || start >= to) {
+            break;
+        }
+        
+        uint32_t length = free_run_length(start, count);
+        if (length >= count) {
+            return start;
+        }
+        if (length > *best_length) {
+            *best_start = start;
+            *best_length = length;
+        }
+        cluster = start + length + 1;
+    }
+    return 0;
+}
+
+// Allocate up to 'count' adjacent free clusters as one chain ending in EOC.
+// The run starts at 'goal' if that cluster is free, so a file can keep
+// growing in place. Otherwise the first run of the full length wins, or
+// failing that the longest run on the volume. Returns the first cluster and
+// stores the run length in *allocated.
+uint32_t fat32_allocate_run(uint32_t count, uint32_t goal, uint32_t* allocated) {
+    *allocated = 0;
+    if (!g_fs.mounted || count == 0 || !fat32_free_map_ready() || g_fs.free_clusters == 0) {
+        return 0;
+    }
+    if (count > g_fs.free_clusters) {
+        count = g_fs.free_clusters;
+    }
+    
+    uint32_t end = g_fs.total_clusters + 2;
+    uint32_t start = 0;
+    uint32_t length = 0;
+    
+    if (goal >= 2 && goal < end) {
+        length = free_run_length(goal, count);
+        if (length > 0) {
+            start = goal;
+        }
+    }
+    
+    if (length < count) {
+        uint32_t hint = g_fs.next_free_cluster;
+        if (hint < 2 || hint >= end) {
+            hint = 2;
+        }
+        
+        uint32_t found = free_run_search(hint, end, count, &start, &length);
+        if (!found) {
+            found = free_run_search(2, hint, count, &start, &length);
+        }
+        if (found) {
+            start = found;
+            length = count;
         }
     }
     
-    return 0; // No free clusters found
+    if (length == 0) {
+        return 0;
+    }
+    
+    for (uint32_t i = 0; i < length; i++) {
+        uint32_t next = (i + 1 < length) ? start + i + 1 : FAT32_EOC;
+        fat32_write_fat_entry(start + i, next);
+    }
+    
+    g_fs.next_free_cluster = start + length;
+    *allocated = length;
+    return start;
 }
 
 // Free a cluster chain
@@ -323,8 +661,6 @@ bool fat32_free_cluster_chain(uint32_t start_cluster) {
             return false;
         }
         
-        g_fs.free_clusters++;
-        
         // Update next_free_cluster hint
         if (current_cluster < g_fs.next_free_cluster) {
             g_fs.next_free_cluster = current_cluster;
@@ -384,15 +720,10 @@ static void fat32_name_to_83(const char* name, uint8_t* fat_name) {
     }
     
     // Find extension
-    const char* ext = NULL;
-    for (int i = strlen(name) - 1; i >= 0; i--) {
-        if (name[i] == '.') {
-            ext = &name[i];
-            break;
-        }
-    }
+    size_t full_len = strlen(name);
+    const char* ext = memrchr(name, '.', full_len);
     
-    int name_len = ext ? (ext - name) : strlen(name);
+    int name_len = ext ? (ext - name) : (int)full_len;
     int ext_len = ext ? strlen(ext + 1) : 0;
     
     // Copy name part (max 8 characters)
@@ -408,79 +739,639 @@ static void fat32_name_to_83(const char* name, uint8_t* fat_name) {
     }
 }
 
-// Find directory entry in a cluster
-static fat32_dir_entry_t* find_dir_entry(uint32_t cluster, const char* name) {
-    if (!fat32_read_cluster(cluster, g_cluster_buffer)) {
-        return NULL;
+// Directory entries are addressed by slot: the entry's index counted from
+// the start of the directory, across all of its clusters.
+
+// Directory index
+//
+// The first time a directory is searched, its cluster chain and a hash
+// table from 8.3 name to slot are built in memory. Lookups then probe the
+// table instead of scanning, a miss is answered without touching the
+// directory at all, and creating an entry starts from a hint below which
+// no slot is free. A few directories are indexed at once; the least
+// recently used index is dropped to make room.
+
+#define FS_DIR_INDEXES      8
+#define FS_DIR_TABLE_MIN    64
+#define FS_DIR_SLOT_EMPTY   0
+#define FS_DIR_SLOT_REMOVED 0xFFFFFFFF
+
+typedef struct {
+    uint32_t hash;                  // Hash of the 8.3 name
+    uint32_t slot;                  // Slot + 1, or one of the markers above
+} fs_dir_hash_t;
+
+typedef struct {
+    uint32_t dir_cluster;           // First cluster of the directory (0 = unused)
+    uint32_t* clusters;             // Cluster chain
+    uint32_t cluster_count;
+    uint32_t cluster_capacity;
+    fs_dir_hash_t* table;           // Open addressing, power of two
+    uint32_t table_size;
+    uint32_t table_used;            // Live and removed entries
+    uint32_t free_hint;             // No free slot below this one
+    uint32_t last_used;
+} fs_dir_index_t;
+
+static fs_dir_index_t g_dir_indexes[FS_DIR_INDEXES];
+static uint32_t g_dir_index_tick = 0;
+
+// FNV-1a over an 8.3 name
+static uint32_t fs_name_hash(const uint8_t* fat_name) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < 11; i++) {
+        hash = (hash ^ fat_name[i]) * 16777619u;
     }
-    
-    fat32_dir_entry_t* entries = (fat32_dir_entry_t*)g_cluster_buffer;
-    int entries_per_cluster = g_fs.bytes_per_cluster / sizeof(fat32_dir_entry_t);
-    
-    uint8_t fat_name[11];
-    fat32_name_to_83(name, fat_name);
-    
-    for (int i = 0; i < entries_per_cluster; i++) {
-        if (entries[i].name[0] == 0) {
-            break; // End of directory
+    return hash;
+}
+
+static void dir_index_free(fs_dir_index_t* index) {
+    free(index->clusters);
+    free(index->table);
+    memset(index, 0, sizeof(fs_dir_index_t));
+}
+
+static void dir_index_reset(void) {
+    for (int i = 0; i < FS_DIR_INDEXES; i++) {
+        dir_index_free(&g_dir_indexes[i]);
+    }
+    g_dir_index_tick = 0;
+}
+
+// Index of a directory if one has been built
+static fs_dir_index_t* dir_index_peek(uint32_t dir_cluster) {
+    for (int i = 0; i < FS_DIR_INDEXES; i++) {
+        if (g_dir_indexes[i].dir_cluster == dir_cluster) {
+            return &g_dir_indexes[i];
         }
-        
-        if (entries[i].name[0] == 0xE5) {
-            continue; // Deleted entry
+    }
+    return NULL;
+}
+
+static void dir_index_drop(uint32_t dir_cluster) {
+    fs_dir_index_t* index = dir_index_peek(dir_cluster);
+    if (index) {
+        dir_index_free(index);
+    }
+}
+
+static bool dir_index_add_cluster(fs_dir_index_t* index, uint32_t cluster) {
+    if (index->cluster_count == index->cluster_capacity) {
+        uint32_t capacity = index->cluster_capacity ? index->cluster_capacity * 2 : 4;
+        uint32_t* clusters = (uint32_t*)realloc(index->clusters, capacity * sizeof(uint32_t));
+        if (!clusters) {
+            return false;
         }
-        
-        if (entries[i].attributes == ATTR_LONG_NAME) {
-            continue; // Skip long filename entries for now
+        index->clusters = clusters;
+        index->cluster_capacity = capacity;
+    }
+    index->clusters[index->cluster_count++] = cluster;
+    return true;
+}
+
+static void dir_index_place(fs_dir_hash_t* table, uint32_t size, uint32_t hash, uint32_t slot) {
+    uint32_t i = hash & (size - 1);
+    while (table[i].slot != FS_DIR_SLOT_EMPTY && table[i].slot != FS_DIR_SLOT_REMOVED) {
+        i = (i + 1) & (size - 1);
+    }
+    table[i].hash = hash;
+    table[i].slot = slot + 1;
+}
+
+// Add a name. The table doubles (dropping removed markers) at 3/4 full.
+static bool dir_index_insert(fs_dir_index_t* index, const uint8_t* fat_name, uint32_t slot) {
+    if ((index->table_used + 1) * 4 > index->table_size * 3) {
+        uint32_t size = index->table_size ? index->table_size * 2 : FS_DIR_TABLE_MIN;
+        fs_dir_hash_t* table = (fs_dir_hash_t*)calloc(size, sizeof(fs_dir_hash_t));
+        if (!table) {
+            return false;
         }
         
-        // Compare names
-        bool match = true;
-        for (int j = 0; j < 11; j++) {
-            if (entries[i].name[j] != fat_name[j]) {
-                match = false;
-                break;
+        index->table_used = 0;
+        for (uint32_t i = 0; i < index->table_size; i++) {
+            uint32_t old = index->table[i].slot;
+            if (old != FS_DIR_SLOT_EMPTY && old != FS_DIR_SLOT_REMOVED) {
+                dir_index_place(table, size, index->table[i].hash, old - 1);
+                index->table_used++;
             }
         }
-        
-        if (match) {
-            return &entries[i];
-        }
+        free(index->table);
+        index->table = table;
+        index->table_size = size;
     }
     
-    return NULL;
+    dir_index_place(index->table, index->table_size, fs_name_hash(fat_name), slot);
+    index->table_used++;
+    return true;
 }
 
-// Find free directory entry slot
-static int find_free_dir_entry_slot(uint32_t cluster) {
-    if (!fat32_read_cluster(cluster, g_cluster_buffer)) {
-        return -1;
+static void dir_index_remove(fs_dir_index_t* index, const uint8_t* fat_name, uint32_t slot) {
+    if (!index->table) {
+        return;
     }
     
-    fat32_dir_entry_t* entries = (fat32_dir_entry_t*)g_cluster_buffer;
-    int entries_per_cluster = g_fs.bytes_per_cluster / sizeof(fat32_dir_entry_t);
+    uint32_t mask = index->table_size - 1;
+    for (uint32_t i = fs_name_hash(fat_name) & mask; index->table[i].slot != FS_DIR_SLOT_EMPTY; i = (i + 1) & mask) {
+        if (index->table[i].slot == slot + 1) {
+            index->table[i].slot = FS_DIR_SLOT_REMOVED;
+            break;
+        }
+    }
+    if (slot < index->free_hint) {
+        index->free_hint = slot;
+    }
+}
+
+// Index for a directory, building it on first use. NULL when out of memory
+// or the directory cannot be read; callers then scan as before.
+static fs_dir_index_t* dir_index_get(uint32_t dir_cluster) {
+    fs_dir_index_t* index = dir_index_peek(dir_cluster);
+    if (index) {
+        index->last_used = ++g_dir_index_tick;
+        return index;
+    }
+    
+    index = &g_dir_indexes[0];
+    for (int i = 1; i < FS_DIR_INDEXES && index->dir_cluster != 0; i++) {
+        if (g_dir_indexes[i].dir_cluster == 0 || g_dir_indexes[i].last_used < index->last_used) {
+            index = &g_dir_indexes[i];
+        }
+    }
+    dir_index_free(index);
+    
+    uint32_t entries_per_cluster = g_fs.bytes_per_cluster / sizeof(fat32_dir_entry_t);
+    bool at_end = false;
+    index->free_hint = FS_DIR_SLOT_REMOVED;
     
-    for (int i = 0; i < entries_per_cluster; i++) {
-        if (entries[i].name[0] == 0 || entries[i].name[0] == 0xE5) {
-            return i; // Found free slot
+    for (uint32_t cluster = dir_cluster; cluster >= 2 && cluster < FAT32_EOC;
+         cluster = fat32_read_fat_entry(cluster)) {
+        if (!dir_index_add_cluster(index, cluster)) {
+            dir_index_free(index);
+            return NULL;
+        }
+        if (at_end) {
+            continue; // Only the chain is needed past the end marker
+        }
+        
+        if (!fat32_read_cluster(cluster, g_dir_buffer)) {
+            dir_index_free(index);
+            return NULL;
+        }
+        
+        fat32_dir_entry_t* entries = (fat32_dir_entry_t*)g_dir_buffer;
+        uint32_t base = (index->cluster_count - 1) * entries_per_cluster;
+        for (uint32_t i = 0; i < entries_per_cluster; i++) {
+            uint32_t slot = base + i;
+            if (entries[i].name[0] == 0 || entries[i].name[0] == 0xE5) {
+                if (slot < index->free_hint) {
+                    index->free_hint = slot;
+                }
+                if (entries[i].name[0] == 0) {
+                    at_end = true;
+                    break;
+                }
+                continue;
+            }
+            if (entries[i].attributes == ATTR_LONG_NAME) {
+                continue;
+            }
+            if (!dir_index_insert(index, entries[i].name, slot)) {
+                dir_index_free(index);
+                return NULL;
+            }
         }
     }
     
-    return -1; // No free slots
+    if (index->cluster_count == 0) {
+        dir_index_free(index);
+        return NULL;
+    }
+    if (index->free_hint == FS_DIR_SLOT_REMOVED) {
+        index->free_hint = index->cluster_count * entries_per_cluster; // Full
+    }
+    index->dir_cluster = dir_cluster;
+    index->last_used = ++g_dir_index_tick;
+    return index;
 }
 
-// Create directory entry
-static bool create_dir_entry(uint32_t parent_cluster, const char* name, uint32_t first_cluster, uint32_t size, uint8_t attributes) {
-    if (!fat32_read_cluster(parent_cluster, g_cluster_buffer)) {
+// Sector holding directory slot 'slot', or 0 past the end of the chain
+static uint32_t dir_slot_sector(uint32_t dir_cluster, uint32_t slot) {
+    uint32_t entries_per_cluster = g_fs.bytes_per_cluster / sizeof(fat32_dir_entry_t);
+    uint32_t cluster = dir_cluster;
+    fs_dir_index_t* index = dir_index_peek(dir_cluster);
+    if (index) {
+        if (slot / entries_per_cluster >= index->cluster_count) {
+            return 0;
+        }
+        cluster = index->clusters[slot / entries_per_cluster];
+    } else {
+        for (uint32_t i = slot / entries_per_cluster; i > 0 && cluster >= 2 && cluster < FAT32_EOC; i--) {
+            cluster = fat32_read_fat_entry(cluster);
+        }
+    }
+    if (cluster < 2 || cluster >= FAT32_EOC) {
+        return 0;
+    }
+    
+    uint32_t offset = (slot % entries_per_cluster) * sizeof(fat32_dir_entry_t);
+    return cluster_to_sector(cluster) + offset / SECTOR_SIZE;
+}
+
+// Directory entry 'slot' inside a held cache buffer. The caller releases
+// *buf_out, after bcache_mark_dirty() if it changed the entry.
+static fat32_dir_entry_t* dir_entry_get(uint32_t dir_cluster, uint32_t slot, bcache_buf_t** buf_out) {
+    if (!storage_ready()) {
+        return NULL;
+    }
+    uint32_t sector = dir_slot_sector(dir_cluster, slot);
+    if (sector == 0) {
+        return NULL;
+    }
+    
+    bcache_buf_t* buf = bcache_get(BCACHE_DEV_RAMDISK, sector, true);
+    if (!buf) {
+        return NULL;
+    }
+    
+    *buf_out = buf;
+    uint32_t offset = (slot * sizeof(fat32_dir_entry_t)) % SECTOR_SIZE;
+    return (fat32_dir_entry_t*)(buf->data + offset);
+}
+
+static bool dir_entry_read(uint32_t dir_cluster, uint32_t slot, fat32_dir_entry_t* out) {
+    bcache_buf_t* buf;
+    fat32_dir_entry_t* entry = dir_entry_get(dir_cluster, slot, &buf);
+    if (!entry) {
+        return false;
+    }
+    memcpy(out, entry, sizeof(fat32_dir_entry_t));
+    bcache_release(buf);
+    return true;
+}
+
+// Scan a directory for an 8.3 name, following its cluster chain. Returns
+// the slot or -1.
+static int find_dir_slot(uint32_t dir_cluster, const uint8_t* fat_name, fat32_dir_entry_t* out) {
+    int entries_per_cluster = g_fs.bytes_per_cluster / sizeof(fat32_dir_entry_t);
+    int base = 0;
+    
+    for (uint32_t cluster = dir_cluster; cluster >= 2 && cluster < FAT32_EOC;
+         cluster = fat32_read_fat_entry(cluster)) {
+        if (!fat32_read_cluster(cluster, g_dir_buffer)) {
+            return -1;
+        }
+        
+        fat32_dir_entry_t* entries = (fat32_dir_entry_t*)g_dir_buffer;
+        for (int i = 0; i < entries_per_cluster; i++) {
+            if (entries[i].name[0] == 0) {
+                return -1; // End of directory
+            }
+            
+            if (entries[i].name[0] == 0xE5) {
+                continue; // Deleted entry
+            }
+            
+            if (entries[i].attributes == ATTR_LONG_NAME) {
+                continue; // Skip long filename entries for now
+            }
+            
+            if (memcmp(entries[i].name, fat_name, 11) == 0) {
+                memcpy(out, &entries[i], sizeof(fat32_dir_entry_t));
+                return base + i;
+            }
+        }
+        base += entries_per_cluster;
+    }
+    
+    return -1;
+}
+
+// Look a name up through the directory index. Returns the slot or -1.
+static int dir_index_find(fs_dir_index_t* index, const uint8_t* fat_name, fat32_dir_entry_t* out) {
+    if (!index->table) {
+        return -1;
+    }
+    
+    uint32_t hash = fs_name_hash(fat_name);
+    uint32_t mask = index->table_size - 1;
+    for (uint32_t i = hash & mask; index->table[i].slot != FS_DIR_SLOT_EMPTY; i = (i + 1) & mask) {
+        uint32_t stored = index->table[i].slot;
+        if (stored == FS_DIR_SLOT_REMOVED || index->table[i].hash != hash) {
+            continue;
+        }
+        if (dir_entry_read(index->dir_cluster, stored - 1, out) && memcmp(out->name, fat_name, 11) == 0) {
+            return stored - 1;
+        }
+    }
+    return -1;
+}
+
+// Directory entry cache
+//
+// Remembers (directory, 8.3 name) -> slot for names that were looked up,
+// and also names that were looked up and not found. A warm lookup reads
+// the one entry through the buffer cache instead of scanning the
+// directory. Creating, renaming and deleting entries keep it up to date;
+// it is emptied at mount and unmount.
+
+#define FS_DCACHE_ENTRIES  128
+#define FS_DCACHE_BUCKETS  64
+#define FS_DENTRY_NEGATIVE 0xFFFFFFFF
+
+typedef struct fs_dentry {
+    uint32_t dir_cluster;           // Directory holding the name (0 = unused)
+    uint8_t  name[11];              // 8.3 name
+    uint32_t slot;                  // Slot in the directory or FS_DENTRY_NEGATIVE
+    uint32_t last_used;             // Lookup tick for eviction
+    struct fs_dentry* hash_next;
+} fs_dentry_t;
+
+static fs_dentry_t g_dentries[FS_DCACHE_ENTRIES];
+static fs_dentry_t* g_dentry_hash[FS_DCACHE_BUCKETS];
+static uint32_t g_dentry_tick = 0;
+
+static void dcache_reset(void) {
+    memset(g_dentries, 0, sizeof(g_dentries));
+    memset(g_dentry_hash, 0, sizeof(g_dentry_hash));
+    g_dentry_tick = 0;
+}
+
+static uint32_t dcache_bucket(uint32_t dir_cluster, const uint8_t* fat_name) {
+    return (fs_name_hash(fat_name) ^ (dir_cluster * 2654435761u)) % FS_DCACHE_BUCKETS;
+}
+
+static fs_dentry_t* dcache_find(uint32_t dir_cluster, const uint8_t* fat_name) {
+    fs_dentry_t* dentry = g_dentry_hash[dcache_bucket(dir_cluster, fat_name)];
+    while (dentry) {
+        if (dentry->dir_cluster == dir_cluster && memcmp(dentry->name, fat_name, 11) == 0) {
+            dentry->last_used = ++g_dentry_tick;
+            return dentry;
+        }
+        dentry = dentry->hash_next;
+    }
+    return NULL;
+}
+
+static void dcache_unlink(fs_dentry_t* dentry) {
+    fs_dentry_t** link = &g_dentry_hash[dcache_bucket(dentry->dir_cluster, dentry->name)];
+    while (*link && *link != dentry) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = dentry->hash_next;
+    }
+    dentry->dir_cluster = 0;
+    dentry->hash_next = NULL;
+}
+
+static void dcache_store(uint32_t dir_cluster, const uint8_t* fat_name, uint32_t slot) {
+    fs_dentry_t* dentry = dcache_find(dir_cluster, fat_name);
+    if (dentry) {
+        dentry->slot = slot;
+        return;
+    }
+    
+    // Take an unused entry, or the least recently used one
+    dentry = &g_dentries[0];
+    for (int i = 0; i < FS_DCACHE_ENTRIES && dentry->dir_cluster != 0; i++) {
+        if (g_dentries[i].dir_cluster == 0 || g_dentries[i].last_used < dentry->last_used) {
+            dentry = &g_dentries[i];
+        }
+    }
+    if (dentry->dir_cluster != 0) {
+        dcache_unlink(dentry);
+    }
+    
+    uint32_t bucket = dcache_bucket(dir_cluster, fat_name);
+    dentry->dir_cluster = dir_cluster;
+    memcpy(dentry->name, fat_name, 11);
+    dentry->slot = slot;
+    dentry->last_used = ++g_dentry_tick;
+    dentry->hash_next = g_dentry_hash[bucket];
+    g_dentry_hash[bucket] = dentry;
+}
+
+// Forget every name in a directory that is going away
+static void dcache_drop_dir(uint32_t dir_cluster) {
+    for (int i = 0; i < FS_DCACHE_ENTRIES; i++) {
+        if (g_dentries[i].dir_cluster == dir_cluster) {
+            dcache_unlink(&g_dentries[i]);
+        }
+    }
+}
+
+// Look an 8.3 name up in a directory, through the entry cache
+static bool dir_lookup_83(uint32_t dir_cluster, const uint8_t* fat_name, fat32_dir_entry_t* out, uint32_t* slot_out) {
+    fs_dentry_t* dentry = dcache_find(dir_cluster, fat_name);
+    if (dentry) {
+        if (dentry->slot == FS_DENTRY_NEGATIVE) {
+            return false;
+        }
+        if (dir_entry_read(dir_cluster, dentry->slot, out) && memcmp(out->name, fat_name, 11) == 0) {
+            if (slot_out) {
+                *slot_out = dentry->slot;
+            }
+            return true;
+        }
+    }
+    
+    fs_dir_index_t* index = dir_index_get(dir_cluster);
+    int slot = index ? dir_index_find(index, fat_name, out) : find_dir_slot(dir_cluster, fat_name, out);
+    if (slot < 0) {
+        dcache_store(dir_cluster, fat_name, FS_DENTRY_NEGATIVE);
         return false;
     }
     
-    int slot = find_free_dir_entry_slot(parent_cluster);
-    if (slot == -1) {
+    dcache_store(dir_cluster, fat_name, slot);
+    if (slot_out) {
+        *slot_out = slot;
+    }
+    return true;
+}
+
+static bool dir_lookup(uint32_t dir_cluster, const char* name, fat32_dir_entry_t* entry, uint32_t* slot_out) {
+    uint8_t fat_name[11];
+    fat32_name_to_83(name, fat_name);
+    return dir_lookup_83(dir_cluster, fat_name, entry, slot_out);
+}
+
+static uint32_t dir_entry_cluster(const fat32_dir_entry_t* entry) {
+    return ((uint32_t)entry->first_cluster_high << 16) | entry->first_cluster_low;
+}
+
+// Parent of a directory, found through its ".." entry
+static uint32_t dir_parent(uint32_t dir_cluster) {
+    static const uint8_t dotdot[11] = { '.', '.', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ' };
+    
+    if (dir_cluster == g_fs.root_cluster) {
+        return dir_cluster;
+    }
+    
+    fat32_dir_entry_t entry;
+    if (!dir_lookup_83(dir_cluster, dotdot, &entry, NULL)) {
+        return g_fs.root_cluster;
+    }
+    uint32_t parent = dir_entry_cluster(&entry);
+    return parent < 2 ? g_fs.root_cluster : parent;
+}
+
+// Path resolution
+//
+// Paths are walked one component at a time from the root ("/a/b") or the
+// current directory ("a/b"), with "." and ".." understood at any depth.
+
+// Find the directory holding the last component of 'path'. Its cluster
+// goes to dir_out and the component to leaf, which is left empty when the
+// path ends in a slash or is just "/".
+static bool fs_resolve(const char* path, uint32_t* dir_out, char* leaf) {
+    uint32_t dir = (path[0] == '/') ? g_fs.root_cluster : g_cwd.cluster;
+    leaf[0] = '\0';
+    
+    while (*path) {
+        while (*path == '/') {
+            path++;
+        }
+        if (!*path) {
+            break;
+        }
+        
+        char component[FS_MAX_NAME_LENGTH];
+        size_t length = 0;
+        while (*path && *path != '/') {
+            if (length < FS_MAX_NAME_LENGTH - 1) {
+                component[length++] = *path;
+            }
+            path++;
+        }
+        component[length] = '\0';
+        
+        if (!*path) {
+            strcpy(leaf, component); // Last component
+            break;
+        }
+        
+        if (strcmp(component, ".") == 0) {
+            continue;
+        }
+        if (strcmp(component, "..") == 0) {
+            dir = dir_parent(dir);
+            continue;
+        }
+        
+        fat32_dir_entry_t entry;
+        if (!dir_lookup(dir, component, &entry, NULL) || !(entry.attributes & ATTR_DIRECTORY)) {
+            return false;
+        }
+        dir = dir_entry_cluster(&entry);
+        if (dir < 2) {
+            dir = g_fs.root_cluster;
+        }
+    }
+    
+    *dir_out = dir;
+    return true;
+}
+
+// Resolve a path that has to name a directory
+static bool fs_resolve_dir(const char* path, uint32_t* dir_out) {
+    char leaf[FS_MAX_NAME_LENGTH];
+    uint32_t dir;
+    if (!fs_resolve(path, &dir, leaf)) {
+        return false;
+    }
+    
+    if (leaf[0] == '\0' || strcmp(leaf, ".") == 0) {
+        *dir_out = dir;
+        return true;
+    }
+    if (strcmp(leaf, "..") == 0) {
+        *dir_out = dir_parent(dir);
+        return true;
+    }
+    
+    fat32_dir_entry_t entry;
+    if (!dir_lookup(dir, leaf, &entry, NULL) || !(entry.attributes & ATTR_DIRECTORY)) {
+        return false;
+    }
+    *dir_out = dir_entry_cluster(&entry);
+    if (*dir_out < 2) {
+        *dir_out = g_fs.root_cluster;
+    }
+    return true;
+}
+
+// Add a zeroed cluster to the end of a directory
+static bool dir_grow(uint32_t dir_cluster, fs_dir_index_t* index) {
+    uint32_t last = dir_cluster;
+    if (index) {
+        last = index->clusters[index->cluster_count - 1];
+    } else {
+        for (uint32_t next = fat32_read_fat_entry(last); next >= 2 && next < FAT32_EOC;
+             next = fat32_read_fat_entry(last)) {
+            last = next;
+        }
+    }
+    
+    uint32_t new_cluster = fat32_allocate_cluster();
+    if (new_cluster == 0) {
+        return false;
+    }
+    
+    memset(g_dir_buffer, 0, g_fs.bytes_per_cluster);
+    if (!fat32_write_cluster(new_cluster, g_dir_buffer)) {
+        fat32_free_cluster_chain(new_cluster);
+        return false;
+    }
+    fat32_write_fat_entry(last, new_cluster);
+    
+    if (index && !dir_index_add_cluster(index, new_cluster)) {
+        dir_index_free(index);
+    }
+    return true;
+}
+
+// Find a free slot in a directory, growing it when every slot is in use
+static bool dir_alloc_slot(uint32_t dir_cluster, uint32_t* slot_out) {
+    fs_dir_index_t* index = dir_index_get(dir_cluster);
+    uint32_t slot = index ? index->free_hint : 0;
+    
+    for (;; slot++) {
+        bcache_buf_t* buf;
+        fat32_dir_entry_t* entry = dir_entry_get(dir_cluster, slot, &buf);
+        if (!entry) {
+            break; // Past the last cluster
+        }
+        bool free_slot = (entry->name[0] == 0 || entry->name[0] == 0xE5);
+        bcache_release(buf);
+        if (free_slot) {
+            break;
+        }
+    }
+    
+    if (dir_slot_sector(dir_cluster, slot) == 0 && !dir_grow(dir_cluster, index)) {
+        return false;
+    }
+    
+    index = dir_index_peek(dir_cluster); // Growing may have dropped it
+    if (index) {
+        index->free_hint = slot + 1;
+    }
+    *slot_out = slot;
+    return true;
+}
+
+// Create directory entry
+static bool create_dir_entry(uint32_t parent_cluster, const char* name, uint32_t first_cluster, uint32_t size, uint8_t attributes, uint32_t* slot_out) {
+    uint32_t slot;
+    if (!dir_alloc_slot(parent_cluster, &slot)) {
         return false; // No free slots
     }
     
-    fat32_dir_entry_t* entries = (fat32_dir_entry_t*)g_cluster_buffer;
-    fat32_dir_entry_t* entry = &entries[slot];
+    bcache_buf_t* buf;
+    fat32_dir_entry_t* entry = dir_entry_get(parent_cluster, slot, &buf);
+    if (!entry) {
+        return false;
+    }
     
     // Convert filename to 8.3 format
     fat32_name_to_83(name, entry->name);
@@ -498,57 +1389,537 @@ static bool create_dir_entry(uint32_t parent_cluster, const char* name, uint32_t
     entry->first_cluster_low = first_cluster & 0xFFFF;
     entry->file_size = size;
     
-    // Write back the cluster
-    return fat32_write_cluster(parent_cluster, g_cluster_buffer);
+    if (slot_out) {
+        *slot_out = slot;
+    }
+    
+    fs_dir_index_t* index = dir_index_peek(parent_cluster);
+    if (index && !dir_index_insert(index, entry->name, slot)) {
+        dir_index_free(index);
+    }
+    dcache_store(parent_cluster, entry->name, slot);
+    
+    bcache_mark_dirty(buf);
+    bcache_release(buf);
+    return true;
 }
 
-// Open a file
-fs_file_handle_t* fs_open(const char* path, const char* mode) {
-    if (!g_fs.mounted || !path) {
+// Mark a directory entry deleted and remember that the name is gone
+static bool dir_entry_remove(uint32_t dir_cluster, uint32_t slot) {
+    bcache_buf_t* buf;
+    fat32_dir_entry_t* entry = dir_entry_get(dir_cluster, slot, &buf);
+    if (!entry) {
+        return false;
+    }
+    
+    fs_dir_index_t* index = dir_index_peek(dir_cluster);
+    if (index) {
+        dir_index_remove(index, entry->name, slot);
+    }
+    dcache_store(dir_cluster, entry->name, FS_DENTRY_NEGATIVE);
+    entry->name[0] = 0xE5;
+    bcache_mark_dirty(buf);
+    bcache_release(buf);
+    return true;
+}
+
+// Allocate a handle from the handle cache and link it into the open list
+static fs_file_handle_t* fs_alloc_handle(void) {
+    fs_file_handle_t* handle = (fs_file_handle_t*)slab_alloc(g_handle_cache);
+    if (!handle) {
         return NULL;
     }
     
-    // Find free file handle
-    fs_file_handle_t* handle = NULL;
-    for (int i = 0; i < 32; i++) {
-        if (!g_file_handles[i].in_use) {
-            handle = &g_file_handles[i];
+    memset(handle, 0, sizeof(fs_file_handle_t));
+    handle->in_use = true;
+    handle->ra_last = 0xFFFFFFFF; // Reading from the start counts as sequential
+    handle->next_open = g_open_handles;
+    g_open_handles = handle;
+    return handle;
+}
+
+// First open handle whose directory entry is 'slot' in 'dir_cluster'
+static fs_file_handle_t* fs_handle_on_entry(uint32_t dir_cluster, uint32_t slot) {
+    for (fs_file_handle_t* handle = g_open_handles; handle; handle = handle->next_open) {
+        if (handle->dir_cluster == dir_cluster && handle->dir_index == slot) {
+            return handle;
+        }
+    }
+    return NULL;
+}
+
+// Point the handles open on an entry at where it now lives, so their size
+// and first cluster are written to the right slot at flush and close
+static void fs_handles_move_entry(uint32_t old_dir, uint32_t old_slot,
+                                  uint32_t new_dir, uint32_t new_slot, const uint8_t* fat_name) {
+    for (fs_file_handle_t* handle = g_open_handles; handle; handle = handle->next_open) {
+        if (handle->dir_cluster == old_dir && handle->dir_index == old_slot) {
+            handle->dir_cluster = new_dir;
+            handle->dir_index = new_slot;
+            fat32_83_to_name(fat_name, handle->filename);
+        }
+    }
+}
+
+// Extent maps
+//
+// Each handle keeps its cluster chain as a sorted list of runs, built from
+// the in-memory FAT at open time and extended as clusters are allocated.
+// Seeking is a binary search and finding the tail for an append is a
+// lookup of the last run. If the list cannot be allocated the handle falls
+// back to walking the FAT.
+
+#define FS_EXTENTS_INITIAL 4
+
+static bool fs_extent_append(fs_file_handle_t* handle, uint32_t cluster) {
+    if (handle->extent_count > 0) {
+        fs_extent_t* last = &handle->extents[handle->extent_count - 1];
+        if (last->start_cluster + last->length == cluster) {
+            last->length++;
+            handle->cluster_count++;
+            return true;
+        }
+    }
+    
+    if (handle->extent_count == handle->extent_capacity) {
+        uint32_t capacity = handle->extent_capacity ? handle->extent_capacity * 2 : FS_EXTENTS_INITIAL;
+        fs_extent_t* extents = (fs_extent_t*)realloc(handle->extents, capacity * sizeof(fs_extent_t));
+        if (!extents) {
+            return false;
+        }
+        handle->extents = extents;
+        handle->extent_capacity = capacity;
+    }
+    
+    fs_extent_t* extent = &handle->extents[handle->extent_count++];
+    extent->file_cluster = handle->cluster_count;
+    extent->start_cluster = cluster;
+    extent->length = 1;
+    handle->cluster_count++;
+    return true;
+}
+
+static void fs_extents_free(fs_file_handle_t* handle) {
+    free(handle->extents);
+    handle->extents = NULL;
+    handle->extent_count = 0;
+    handle->extent_capacity = 0;
+    handle->cluster_count = 0;
+}
+
+// Build the extent list from the FAT. A chain longer than the volume is
+// corrupt (a loop); keep what was read up to that point.
+static void fs_extents_build(fs_file_handle_t* handle) {
+    fs_extents_free(handle);
+    
+    uint32_t cluster = handle->first_cluster;
+    uint32_t limit = g_fs.total_clusters;
+    while (cluster >= 2 && cluster < FAT32_EOC && limit-- > 0) {
+        if (!fs_extent_append(handle, cluster)) {
+            fs_extents_free(handle);
+            return;
+        }
+        cluster = fat32_read_fat_entry(cluster);
+    }
+}
+
+// Cluster number 'index' of the file, or FAT32_EOC past the end of the chain
+static uint32_t fs_chain_cluster(fs_file_handle_t* handle, uint32_t index) {
+    if (!handle->extents) {
+        uint32_t cluster = handle->first_cluster;
+        while (index-- > 0 && cluster >= 2 && cluster < FAT32_EOC) {
+            cluster = fat32_read_fat_entry(cluster);
+        }
+        return (cluster >= 2 && cluster < FAT32_EOC) ? cluster : FAT32_EOC;
+    }
+    
+    if (index >= handle->cluster_count) {
+        return FAT32_EOC;
+    }
+    
+    uint32_t low = 0;
+    uint32_t high = handle->extent_count;
+    while (high - low > 1) {
+        uint32_t mid = (low + high) / 2;
+        if (handle->extents[mid].file_cluster <= index) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    
+    const fs_extent_t* extent = &handle->extents[low];
+    return extent->start_cluster + (index - extent->file_cluster);
+}
+
+// Last cluster of the file's chain, 0 if it has none
+static uint32_t fs_chain_last(fs_file_handle_t* handle) {
+    if (handle->extents) {
+        if (handle->extent_count == 0) {
+            return 0;
+        }
+        const fs_extent_t* last = &handle->extents[handle->extent_count - 1];
+        return last->start_cluster + last->length - 1;
+    }
+    
+    uint32_t last_cluster = handle->first_cluster;
+    if (last_cluster < 2) {
+        return 0;
+    }
+    while (true) {
+        uint32_t next = fat32_read_fat_entry(last_cluster);
+        if (next < 2 || next >= FAT32_EOC) {
             break;
         }
+        last_cluster = next;
+    }
+    return last_cluster;
+}
+
+// Record a cluster just linked onto the end of the chain
+static void fs_chain_extend(fs_file_handle_t* handle, uint32_t cluster) {
+    if (handle->extents && !fs_extent_append(handle, cluster)) {
+        fs_extents_free(handle); // Fall back to walking the FAT
+    }
+}
+
+// Growth policy for fs_write: each extension takes a run at least as large
+// as the rest of the write, and the run doubles while the file keeps
+// growing sequentially.
+#define FS_GROW_MAX 64
+
+// Add up to 'want' clusters to the end of the chain as one run. Returns the
+// first new cluster, 0 if the volume is full.
+static uint32_t fs_grow(fs_file_handle_t* handle, uint32_t want) {
+    uint32_t last = fs_chain_last(handle);
+    uint32_t goal = last ? last + 1 : g_fs.next_free_cluster;
+    uint32_t allocated = 0;
+    
+    uint32_t first = fat32_allocate_run(want, goal, &allocated);
+    if (!first) {
+        return 0;
     }
     
-    if (!handle) {
-        return NULL; // No free handles
+    if (last) {
+        fat32_write_fat_entry(last, first);
+    } else {
+        handle->first_cluster = first;
+        handle->entry_dirty = true;
+    }
+    for (uint32_t i = 0; i < allocated; i++) {
+        fs_chain_extend(handle, first + i);
+    }
+    
+    return first;
+}
+
+// Clusters in the chain
+static uint32_t fs_chain_length(fs_file_handle_t* handle) {
+    if (handle->extents) {
+        return handle->cluster_count;
+    }
+    
+    uint32_t count = 0;
+    uint32_t cluster = handle->first_cluster;
+    while (cluster >= 2 && cluster < FAT32_EOC && count < g_fs.total_clusters) {
+        count++;
+        cluster = fat32_read_fat_entry(cluster);
+    }
+    return count;
+}
+
+// Give back clusters that fs_write preallocated but the file never used
+static void fs_trim_preallocation(fs_file_handle_t* handle) {
+    uint32_t keep = (handle->file_size + g_fs.bytes_per_cluster - 1) / g_fs.bytes_per_cluster;
+    if (keep < 1) {
+        keep = 1;
+    }
+    if (keep < handle->reserved_clusters) {
+        keep = handle->reserved_clusters;
+    }
+    
+    uint32_t tail = fs_chain_cluster(handle, keep - 1);
+    if (tail >= FAT32_EOC) {
+        return;
+    }
+    
+    uint32_t excess = fat32_read_fat_entry(tail);
+    if (excess >= 2 && excess < FAT32_EOC) {
+        fat32_write_fat_entry(tail, FAT32_EOC);
+        fat32_free_cluster_chain(excess);
+    }
+}
+
+bool fs_fallocate(fs_file_handle_t* handle, uint32_t bytes) {
+    if (!handle || !handle->in_use || handle->is_directory) {
+        return false;
+    }
+    
+    uint32_t needed = (bytes + g_fs.bytes_per_cluster - 1) / g_fs.bytes_per_cluster;
+    uint32_t have = fs_chain_length(handle);
+    bool ok = true;
+    
+    while (have < needed) {
+        uint32_t before = have;
+        if (!fs_grow(handle, needed - have)) {
+            ok = false; // Volume full
+            break;
+        }
+        have = fs_chain_length(handle);
+        if (have <= before) {
+            ok = false;
+            break;
+        }
+    }
+    
+    if (needed > handle->reserved_clusters) {
+        handle->reserved_clusters = needed;
     }
     
-    // For now, only support files in current directory
-    uint32_t search_cluster = (path[0] == '/') ? g_fs.root_cluster : g_cwd.cluster;
-    const char* filename = (path[0] == '/') ? path + 1 : path;
+    // A handle sitting at the old end of the chain now has a cluster to use
+    if (handle->current_cluster < 2 || handle->current_cluster >= FAT32_EOC) {
+        handle->current_cluster = fs_chain_cluster(handle, handle->position / g_fs.bytes_per_cluster);
+        handle->cluster_offset = handle->position % g_fs.bytes_per_cluster;
+    }
+    
+    return fat32_flush_fat() && ok;
+}
+
+// Per-handle cluster buffer
+//
+// Writes land in the handle's buffer and reach the disk when the handle
+// moves to another cluster, on fs_flush()/fs_sync() and at close. The
+// file size and first cluster are written to the directory entry at those
+// points too, instead of after every fs_write().
+//
+// A cluster is held by at most one handle at a time. A handle that needs
+// a cluster another handle holds takes the buffered copy over, dirty
+// state included, so two handles on one file never see stale data and
+// never read the same cluster from disk twice.
+
+// Write the buffered cluster back if it was modified
+static bool fs_handle_write_back(fs_file_handle_t* handle) {
+    if (!handle->buffer_dirty) {
+        return true;
+    }
+    if (!fat32_write_cluster(handle->buffer_cluster, handle->buffer)) {
+        return false;
+    }
+    handle->buffer_dirty = false;
+    return true;
+}
+
+// Another open handle with 'cluster' in its buffer
+static fs_file_handle_t* fs_handle_holding(fs_file_handle_t* self, uint32_t cluster) {
+    for (fs_file_handle_t* handle = g_open_handles; handle; handle = handle->next_open) {
+        if (handle != self && handle->buffer && handle->buffer_cluster == cluster) {
+            return handle;
+        }
+    }
+    return NULL;
+}
+
+// Make the buffer hold 'cluster'. With fill false the caller is about to
+// overwrite the whole cluster, so it is not read first.
+static uint8_t* fs_handle_load(fs_file_handle_t* handle, uint32_t cluster, bool fill) {
+    if (handle->buffer && handle->buffer_cluster == cluster) {
+        return handle->buffer;
+    }
+    if (!fs_handle_write_back(handle)) {
+        return NULL;
+    }
+    
+    if (!handle->buffer) {
+        handle->buffer = (uint8_t*)malloc(g_fs.bytes_per_cluster);
+        if (!handle->buffer) {
+            return NULL;
+        }
+    }
     
-    fat32_dir_entry_t* entry = find_dir_entry(search_cluster, filename);
+    handle->buffer_cluster = 0;
+    
+    fs_file_handle_t* holder = fs_handle_holding(handle, cluster);
+    if (holder) {
+        if (fill) {
+            memcpy(handle->buffer, holder->buffer, g_fs.bytes_per_cluster);
+        }
+        handle->buffer_dirty = holder->buffer_dirty;
+        holder->buffer_cluster = 0;
+        holder->buffer_dirty = false;
+    } else if (fill && !fat32_read_cluster(cluster, handle->buffer)) {
+        return NULL;
+    }
+    
+    handle->buffer_cluster = cluster;
+    return handle->buffer;
+}
+
+// Store the file size and first cluster in the directory entry. Only the
+// sector holding the entry is touched.
+static bool fs_handle_write_entry(fs_file_handle_t* handle) {
+    if (!handle->entry_dirty) {
+        return true;
+    }
+    if (handle->dir_cluster < 2) {
+        return false;
+    }
+    
+    bcache_buf_t* buf;
+    fat32_dir_entry_t* entry = dir_entry_get(handle->dir_cluster, handle->dir_index, &buf);
+    if (!entry) {
+        return false;
+    }
+    
+    entry->file_size = handle->file_size;
+    entry->first_cluster_high = (handle->first_cluster >> 16) & 0xFFFF;
+    entry->first_cluster_low = handle->first_cluster & 0xFFFF;
+    bcache_mark_dirty(buf);
+    bcache_release(buf);
+    
+    handle->entry_dirty = false;
+    return true;
+}
+
+bool fs_flush(fs_file_handle_t* handle) {
+    if (!handle || !handle->in_use) {
+        return false;
+    }
+    
+    bool ok = fs_handle_write_back(handle);
+    ok = fs_handle_write_entry(handle) && ok;
+    return fat32_flush_fat() && ok;
+}
+
+bool fs_sync(void) {
+    if (!g_fs.mounted) {
+        return false;
+    }
+    
+    bool ok = true;
+    for (fs_file_handle_t* handle = g_open_handles; handle; handle = handle->next_open) {
+        ok = fs_handle_write_back(handle) && ok;
+        ok = fs_handle_write_entry(handle) && ok;
+    }
+    ok = fat32_flush_fat() && ok;
+    ok = fat32_write_fsinfo() && ok;
+    return bcache_sync(BCACHE_DEV_RAMDISK) && ok;
+}
+
+// Readahead
+//
+// A handle reading cluster after cluster gets the clusters ahead of it
+// pulled into the buffer cache before it asks for them. The window starts
+// small and doubles while access stays sequential; any jump resets it.
+// Adjacent clusters go out as one multi-sector request, and a new batch is
+// only issued once the reader has used up half of the previous one.
+
+#define FS_READAHEAD_MIN 2
+#define FS_READAHEAD_MAX 8
+
+static void fs_readahead_request(uint32_t first_cluster, uint32_t count) {
+    bcache_prefetch(BCACHE_DEV_RAMDISK, cluster_to_sector(first_cluster),
+                    count * g_fs.sectors_per_cluster);
+}
+
+static void fs_readahead(fs_file_handle_t* handle, uint32_t index) {
+    if (index == handle->ra_last) {
+        return; // Still in the same cluster
+    }
+    
+    bool sequential = (index == handle->ra_last + 1);
+    handle->ra_last = index;
+    if (!sequential) {
+        handle->ra_window = 0;
+        handle->ra_end = index + 1;
+        return;
+    }
+    
+    if (handle->ra_window == 0) {
+        handle->ra_window = FS_READAHEAD_MIN;
+    } else if (handle->ra_end <= index + 1 + handle->ra_window / 2) {
+        handle->ra_window *= 2;
+        if (handle->ra_window > FS_READAHEAD_MAX) {
+            handle->ra_window = FS_READAHEAD_MAX;
+        }
+    }
+    
+    // Wait until half of what was read ahead has been consumed
+    if (handle->ra_end > index + 1 + handle->ra_window / 2) {
+        return;
+    }
+    
+    uint32_t data_clusters = (handle->file_size + g_fs.bytes_per_cluster - 1) / g_fs.bytes_per_cluster;
+    uint32_t target = index + 1 + handle->ra_window;
+    if (target > data_clusters) {
+        target = data_clusters;
+    }
+    uint32_t from = (handle->ra_end > index + 1) ? handle->ra_end : index + 1;
+    if (from >= target) {
+        return;
+    }
+    
+    // One request per run of adjacent clusters
+    uint32_t run_start = 0;
+    uint32_t run_length = 0;
+    for (uint32_t i = from; i < target; i++) {
+        uint32_t cluster = fs_chain_cluster(handle, i);
+        if (cluster >= FAT32_EOC) {
+            break;
+        }
+        if (run_length > 0 && cluster == run_start + run_length) {
+            run_length++;
+            continue;
+        }
+        if (run_length > 0) {
+            fs_readahead_request(run_start, run_length);
+        }
+        run_start = cluster;
+        run_length = 1;
+    }
+    if (run_length > 0) {
+        fs_readahead_request(run_start, run_length);
+    }
+    
+    handle->ra_end = target;
+}
+
+// Open a file
+fs_file_handle_t* fs_open(const char* path, const char* mode) {
+    if (!g_fs.mounted || !path) {
+        return NULL;
+    }
+    
+    uint32_t search_cluster;
+    char filename[FS_MAX_NAME_LENGTH];
+    if (!fs_resolve(path, &search_cluster, filename) || !filename[0]) {
+        return NULL;
+    }
+    
+    fat32_dir_entry_t entry;
+    uint32_t slot = 0;
+    bool found = dir_lookup(search_cluster, filename, &entry, &slot);
     
     // Check if we're creating a new file
-    if (!entry && mode && (mode[0] == 'w' || mode[0] == 'a')) {
+    if (!found && mode && (mode[0] == 'w' || mode[0] == 'a')) {
         // Allocate a cluster for the new file
         uint32_t new_cluster = fat32_allocate_cluster();
         if (new_cluster == 0) {
             return NULL; // No free clusters
         }
         
-        // Clear the cluster
-        for (int i = 0; i < g_fs.bytes_per_cluster; i++) {
-            g_cluster_buffer[i] = 0;
-        }
-        fat32_write_cluster(new_cluster, g_cluster_buffer);
-        
         // Create directory entry
-        if (!create_dir_entry(search_cluster, filename, new_cluster, 0, ATTR_ARCHIVE)) {
+        if (!create_dir_entry(search_cluster, filename, new_cluster, 0, ATTR_ARCHIVE, &slot)) {
             fat32_free_cluster_chain(new_cluster);
+            fat32_flush_fat();
             return NULL;
         }
+        fat32_flush_fat();
         
         // Initialize handle for new file
-        handle->in_use = true;
+        fs_file_handle_t* handle = fs_alloc_handle();
+        if (!handle) {
+            return NULL; // Out of memory
+        }
         handle->first_cluster = new_cluster;
         handle->current_cluster = new_cluster;
         handle->cluster_offset = 0;
@@ -556,27 +1927,45 @@ fs_file_handle_t* fs_open(const char* path, const char* mode) {
         handle->position = 0;
         handle->attributes = ATTR_ARCHIVE;
         handle->is_directory = false;
+        handle->dir_cluster = search_cluster;
+        handle->dir_index = slot;
+        handle->direct = strchr(mode, 'd') != NULL;
         strcpy(handle->filename, filename);
+        fs_extents_build(handle);
+        
+        // Clear the cluster; it reaches the disk with the first write-back
+        uint8_t* data = fs_handle_load(handle, new_cluster, false);
+        if (data) {
+            memset(data, 0, g_fs.bytes_per_cluster);
+            handle->buffer_dirty = true;
+        }
         
         return handle;
     }
     
-    if (!entry) {
+    if (!found) {
         return NULL; // File not found
     }
     
     // Initialize handle for existing file
-    handle->in_use = true;
-    handle->first_cluster = (entry->first_cluster_high << 16) | entry->first_cluster_low;
+    fs_file_handle_t* handle = fs_alloc_handle();
+    if (!handle) {
+        return NULL; // Out of memory
+    }
+    handle->first_cluster = dir_entry_cluster(&entry);
     handle->current_cluster = handle->first_cluster;
     handle->cluster_offset = 0;
-    handle->file_size = entry->file_size;
+    handle->file_size = entry.file_size;
     handle->position = 0;
-    handle->attributes = entry->attributes;
-    handle->is_directory = (entry->attributes & ATTR_DIRECTORY) != 0;
+    handle->attributes = entry.attributes;
+    handle->is_directory = (entry.attributes & ATTR_DIRECTORY) != 0;
+    handle->dir_cluster = search_cluster;
+    handle->dir_index = slot;
+    handle->direct = mode && strchr(mode, 'd');
     
     // Copy filename
-    fat32_83_to_name(entry->name, handle->filename);
+    fat32_83_to_name(entry.name, handle->filename);
+    fs_extents_build(handle);
     
     // For append mode, seek to end
     if (mode && mode[0] == 'a') {
@@ -588,9 +1977,86 @@ fs_file_handle_t* fs_open(const char* path, const char* mode) {
 
 // Close a file
 void fs_close(fs_file_handle_t* handle) {
-    if (handle && handle->in_use) {
-        handle->in_use = false;
+    if (!handle || !handle->in_use) {
+        return;
+    }
+    
+    // Unlink from the open handle list
+    fs_file_handle_t** link = &g_open_handles;
+    while (*link && *link != handle) {
+        link = &(*link)->next_open;
+    }
+    if (*link) {
+        *link = handle->next_open;
+    }
+    
+    fs_handle_write_back(handle);
+    if (handle->grow_window > 0 && !handle->is_directory) {
+        fs_trim_preallocation(handle);
+    }
+    fs_handle_write_entry(handle);
+    fat32_flush_fat();
+    fs_extents_free(handle);
+    free(handle->buffer);
+    handle->buffer = NULL;
+    
+    handle->in_use = false;
+    slab_free(g_handle_cache, handle);
+}
+
+// Direct I/O
+//
+// A direct handle at a cluster boundary with at least a cluster left to
+// move transfers the run of adjacent clusters ahead of it in one device
+// request, straight between the caller's memory and the disk. Anything
+// smaller goes through the handle buffer as usual.
+
+// Adjacent clusters from the current one, at most 'max'
+static uint32_t fs_direct_run(fs_file_handle_t* handle, uint32_t max) {
+    uint32_t index = handle->position / g_fs.bytes_per_cluster;
+    uint32_t run = 1;
+    while (run < max && fs_chain_cluster(handle, index + run) == handle->current_cluster + run) {
+        run++;
+    }
+    return run;
+}
+
+// Handle buffers holding clusters of the run are written back before a
+// read, and dropped before a write replaces them
+static bool fs_direct_prepare(uint32_t cluster, uint32_t run, bool writing) {
+    for (fs_file_handle_t* open = g_open_handles; open; open = open->next_open) {
+        if (open->buffer_cluster < cluster || open->buffer_cluster - cluster >= run) {
+            continue;
+        }
+        if (writing) {
+            open->buffer_cluster = 0;
+            open->buffer_dirty = false;
+        } else if (!fs_handle_write_back(open)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool fs_direct_transfer(fs_file_handle_t* handle, uint8_t* data, uint32_t run, bool writing) {
+    uint32_t cluster = handle->current_cluster;
+    if (!fs_direct_prepare(cluster, run, writing)) {
+        return false;
+    }
+    
+    uint32_t sector = cluster_to_sector(cluster);
+    uint32_t count = run * g_fs.sectors_per_cluster;
+    bool ok = writing ? bcache_write_direct(BCACHE_DEV_RAMDISK, sector, count, data)
+                      : bcache_read_direct(BCACHE_DEV_RAMDISK, sector, count, data);
+    if (!ok) {
+        return false;
     }
+    
+    // Land on the cluster after the run
+    uint32_t index = handle->position / g_fs.bytes_per_cluster + run;
+    handle->position += run * g_fs.bytes_per_cluster;
+    handle->current_cluster = fs_chain_cluster(handle, index);
+    return true;
 }
 
 // Read from a file
@@ -612,11 +2078,21 @@ size_t fs_read(fs_file_handle_t* handle, void* buffer, size_t size) {
     uint8_t* output = (uint8_t*)buffer;
     
     while (bytes_read < size && handle->current_cluster >= 2 && handle->current_cluster < FAT32_EOC) {
-        // Read current cluster if needed
-        if (handle->cluster_offset == 0) {
-            if (!fat32_read_cluster(handle->current_cluster, g_cluster_buffer)) {
+        uint32_t whole = (size - bytes_read) / g_fs.bytes_per_cluster;
+        if (handle->direct && handle->cluster_offset == 0 && whole > 0 && storage_ready()) {
+            uint32_t run = fs_direct_run(handle, whole);
+            if (!fs_direct_transfer(handle, output + bytes_read, run, false)) {
                 break;
             }
+            bytes_read += run * g_fs.bytes_per_cluster;
+            continue;
+        }
+        
+        // Bring the current cluster into the handle's buffer
+        fs_readahead(handle, handle->position / g_fs.bytes_per_cluster);
+        uint8_t* data = fs_handle_load(handle, handle->current_cluster, true);
+        if (!data) {
+            break;
         }
         
         // Calculate how much to read from this cluster
@@ -624,9 +2100,7 @@ size_t fs_read(fs_file_handle_t* handle, void* buffer, size_t size) {
         size_t to_read = (size - bytes_read < cluster_remaining) ? size - bytes_read : cluster_remaining;
         
         // Copy data from cluster buffer
-        for (size_t i = 0; i < to_read; i++) {
-            output[bytes_read + i] = g_cluster_buffer[handle->cluster_offset + i];
-        }
+        memcpy(output + bytes_read, data + handle->cluster_offset, to_read);
         
         bytes_read += to_read;
         handle->position += to_read;
@@ -642,127 +2116,153 @@ size_t fs_read(fs_file_handle_t* handle, void* buffer, size_t size) {
     return bytes_read;
 }
 
-// Update file size in directory entry
-static bool update_file_size(const char* filename, uint32_t parent_cluster, uint32_t new_size) {
-    if (!fat32_read_cluster(parent_cluster, g_cluster_buffer)) {
-        return false;
+// Read several buffers back to back in one walk of the chain. Each cluster
+// is loaded once and spread over every piece it covers, so small pieces
+// do not reload or re-read ahead the cluster they share.
+size_t fs_readv(fs_file_handle_t* handle, const fs_iovec_t* iov, int count) {
+    if (!handle || !handle->in_use || !iov || count < 0 || handle->is_directory) {
+        return 0;
     }
     
-    fat32_dir_entry_t* entries = (fat32_dir_entry_t*)g_cluster_buffer;
-    int entries_per_cluster = g_fs.bytes_per_cluster / sizeof(fat32_dir_entry_t);
+    if (handle->position >= handle->file_size) {
+        return 0; // EOF
+    }
+    size_t size = handle->file_size - handle->position;
     
-    uint8_t fat_name[11];
-    fat32_name_to_83(filename, fat_name);
+    size_t total = 0;
+    uint8_t* data = NULL; // Current cluster, once loaded
     
-    for (int i = 0; i < entries_per_cluster; i++) {
-        if (entries[i].name[0] == 0) {
-            break; // End of directory
+    for (int i = 0; i < count && total < size; i++) {
+        if (iov[i].length == 0) {
+            continue;
         }
-        
-        if (entries[i].name[0] == 0xE5) {
-            continue; // Deleted entry
+        if (!iov[i].base) {
+            break;
         }
         
-        if (entries[i].attributes == ATTR_LONG_NAME) {
-            continue; // Skip long filename entries
-        }
+        uint8_t* output = (uint8_t*)iov[i].base;
+        size_t want = (iov[i].length < size - total) ? iov[i].length : size - total;
+        size_t done = 0;
         
-        // Compare names
-        bool match = true;
-        for (int j = 0; j < 11; j++) {
-            if (entries[i].name[j] != fat_name[j]) {
-                match = false;
-                break;
+        while (done < want && handle->current_cluster >= 2 && handle->current_cluster < FAT32_EOC) {
+            uint32_t whole = (want - done) / g_fs.bytes_per_cluster;
+            if (handle->direct && handle->cluster_offset == 0 && whole > 0 && storage_ready()) {
+                uint32_t run = fs_direct_run(handle, whole);
+                if (!fs_direct_transfer(handle, output + done, run, false)) {
+                    break;
+                }
+                done += run * g_fs.bytes_per_cluster;
+                data = NULL;
+                continue;
+            }
+            
+            if (!data) {
+                fs_readahead(handle, handle->position / g_fs.bytes_per_cluster);
+                data = fs_handle_load(handle, handle->current_cluster, true);
+                if (!data) {
+                    break;
+                }
+            }
+            
+            size_t cluster_remaining = g_fs.bytes_per_cluster - handle->cluster_offset;
+            size_t to_read = (want - done < cluster_remaining) ? want - done : cluster_remaining;
+            memcpy(output + done, data + handle->cluster_offset, to_read);
+            
+            done += to_read;
+            handle->position += to_read;
+            handle->cluster_offset += to_read;
+            
+            if (handle->cluster_offset >= g_fs.bytes_per_cluster) {
+                handle->current_cluster = fat32_read_fat_entry(handle->current_cluster);
+                handle->cluster_offset = 0;
+                data = NULL;
             }
         }
         
-        if (match) {
-            entries[i].file_size = new_size;
-            return fat32_write_cluster(parent_cluster, g_cluster_buffer);
+        total += done;
+        if (done < want) {
+            break;
         }
     }
     
-    return false;
+    return total;
 }
 
-// Write to a file
-size_t fs_write(fs_file_handle_t* handle, const void* buffer, size_t size) {
-    if (!handle || !handle->in_use || !buffer || handle->is_directory) {
-        return 0;
-    }
-    
+// Write one piece at the handle's position. 'pending' is how many more bytes
+// the caller will write straight after this piece, so the chain grows for
+// the whole batch at once. The FAT is left for the caller to flush.
+static size_t fs_write_piece(fs_file_handle_t* handle, const uint8_t* input, size_t size, size_t pending) {
     size_t bytes_written = 0;
-    const uint8_t* input = (const uint8_t*)buffer;
     
     while (bytes_written < size) {
         // Check if we need to allocate a new cluster
         if (handle->current_cluster < 2 || handle->current_cluster >= FAT32_EOC) {
-            uint32_t new_cluster = fat32_allocate_cluster();
-            if (new_cluster == 0) {
-                break; // No more free clusters
+            uint32_t want = (size - bytes_written + pending + g_fs.bytes_per_cluster - 1) / g_fs.bytes_per_cluster;
+            if (want < handle->grow_window) {
+                want = handle->grow_window;
+            }
+            if (want > FS_GROW_MAX) {
+                want = FS_GROW_MAX;
             }
             
-            // Clear the new cluster
-            for (int i = 0; i < g_fs.bytes_per_cluster; i++) {
-                g_cluster_buffer[i] = 0;
+            uint32_t new_cluster = fs_grow(handle, want);
+            if (new_cluster == 0) {
+                break; // No more free clusters
             }
             
-            if (handle->first_cluster < 2) {
-                // This is the first cluster for the file
-                handle->first_cluster = new_cluster;
-                handle->current_cluster = new_cluster;
-                handle->cluster_offset = 0;
-            } else {
-                // Link the previous cluster to this new one
-                // We need to find the last cluster in the chain
-                uint32_t last_cluster = handle->first_cluster;
-                while (true) {
-                    uint32_t next = fat32_read_fat_entry(last_cluster);
-                    if (next >= FAT32_EOC) {
-                        break;
-                    }
-                    last_cluster = next;
-                }
-                
-                // Link last cluster to new cluster
-                fat32_write_fat_entry(last_cluster, new_cluster);
-                handle->current_cluster = new_cluster;
-                handle->cluster_offset = 0;
+            handle->grow_window = handle->grow_window ? handle->grow_window * 2 : 1;
+            if (handle->grow_window > FS_GROW_MAX) {
+                handle->grow_window = FS_GROW_MAX;
             }
+            handle->current_cluster = new_cluster;
+            handle->cluster_offset = 0;
         }
         
-        // Read current cluster if we're at the beginning
-        if (handle->cluster_offset == 0) {
-            if (!fat32_read_cluster(handle->current_cluster, g_cluster_buffer)) {
+        uint32_t whole = (size - bytes_written) / g_fs.bytes_per_cluster;
+        if (handle->direct && handle->cluster_offset == 0 && whole > 0 && storage_ready()) {
+            uint32_t run = fs_direct_run(handle, whole);
+            if (!fs_direct_transfer(handle, (uint8_t*)input + bytes_written, run, true)) {
                 break;
             }
+            bytes_written += run * g_fs.bytes_per_cluster;
+            if (handle->position > handle->file_size) {
+                handle->file_size = handle->position;
+                handle->entry_dirty = true;
+            }
+            continue;
         }
         
         // Calculate how much to write to this cluster
         size_t cluster_remaining = g_fs.bytes_per_cluster - handle->cluster_offset;
         size_t to_write = (size - bytes_written < cluster_remaining) ? size - bytes_written : cluster_remaining;
         
-        // Copy data to cluster buffer
-        for (size_t i = 0; i < to_write; i++) {
-            g_cluster_buffer[handle->cluster_offset + i] = input[bytes_written + i];
-        }
-        
-        // Write cluster back to disk
-        if (!fat32_write_cluster(handle->current_cluster, g_cluster_buffer)) {
+        // Only read the cluster in if part of it survives this write
+        bool whole_cluster = (to_write == g_fs.bytes_per_cluster);
+        uint8_t* data = fs_handle_load(handle, handle->current_cluster, !whole_cluster);
+        if (!data) {
             break;
         }
         
-                bytes_written += to_write;
+        memcpy(data + handle->cluster_offset, input + bytes_written, to_write);
+        handle->buffer_dirty = true;
+        
+        bytes_written += to_write;
         handle->position += to_write;
         handle->cluster_offset += to_write;
         
         // Update file size if we've extended it
         if (handle->position > handle->file_size) {
             handle->file_size = handle->position;
+            handle->entry_dirty = true;
         }
         
         // Move to next cluster if current one is full
         if (handle->cluster_offset >= g_fs.bytes_per_cluster) {
+            // A full cluster will not change again soon; write it now
+            if (!fs_handle_write_back(handle)) {
+                break;
+            }
+            
             uint32_t next_cluster = fat32_read_fat_entry(handle->current_cluster);
             if (next_cluster >= FAT32_EOC) {
                 // Need to allocate a new cluster for continued writing
@@ -774,13 +2274,105 @@ size_t fs_write(fs_file_handle_t* handle, const void* buffer, size_t size) {
         }
     }
     
-    // Update file size in directory entry
-    uint32_t parent_cluster = g_cwd.cluster; // Assume current directory for now
-    update_file_size(handle->filename, parent_cluster, handle->file_size);
+    return bytes_written;
+}
+
+// Write to a file
+size_t fs_write(fs_file_handle_t* handle, const void* buffer, size_t size) {
+    if (!handle || !handle->in_use || !buffer || handle->is_directory) {
+        return 0;
+    }
+    
+    size_t bytes_written = fs_write_piece(handle, (const uint8_t*)buffer, size, 0);
+    fat32_flush_fat();
     
     return bytes_written;
 }
 
+// Write several buffers back to back
+size_t fs_writev(fs_file_handle_t* handle, const fs_const_iovec_t* iov, int count) {
+    if (!handle || !handle->in_use || !iov || count < 0 || handle->is_directory) {
+        return 0;
+    }
+    
+    size_t pending = 0;
+    for (int i = 0; i < count; i++) {
+        pending += iov[i].length;
+    }
+    
+    size_t total = 0;
+    for (int i = 0; i < count; i++) {
+        if (iov[i].length == 0) {
+            continue;
+        }
+        if (!iov[i].base) {
+            break;
+        }
+        
+        pending -= iov[i].length;
+        size_t written = fs_write_piece(handle, (const uint8_t*)iov[i].base, iov[i].length, pending);
+        total += written;
+        if (written < iov[i].length) {
+            break;
+        }
+    }
+    
+    fat32_flush_fat();
+    
+    return total;
+}
+
+// Map file data for reading in place
+const void* fs_map(fs_file_handle_t* handle, uint32_t offset, uint32_t length, uint32_t* mapped) {
+    *mapped = 0;
+    if (!handle || !handle->in_use || handle->is_directory || offset >= handle->file_size || length == 0) {
+        return NULL;
+    }
+    if (length > handle->file_size - offset) {
+        length = handle->file_size - offset;
+    }
+    
+    uint32_t index = offset / g_fs.bytes_per_cluster;
+    uint32_t within = offset % g_fs.bytes_per_cluster;
+    uint32_t cluster = fs_chain_cluster(handle, index);
+    if (cluster < 2 || cluster >= FAT32_EOC) {
+        return NULL;
+    }
+    
+    // Take in the following clusters while they are adjacent on disk
+    uint32_t run = 1;
+    while (run * g_fs.bytes_per_cluster - within < length &&
+           fs_chain_cluster(handle, index + run) == cluster + run) {
+        run++;
+    }
+    
+    // Data still buffered in a handle has to reach the disk first
+    for (fs_file_handle_t* open = g_open_handles; open; open = open->next_open) {
+        if (open->buffer_dirty && open->buffer_cluster >= cluster &&
+            open->buffer_cluster - cluster < run && !fs_handle_write_back(open)) {
+            return NULL;
+        }
+    }
+    
+    uint32_t skip = within / SECTOR_SIZE;
+    uint32_t sectors = run * g_fs.sectors_per_cluster - skip;
+    const uint8_t* data = storage_map_sectors(cluster_to_sector(cluster) + skip, &sectors);
+    if (data && sectors > 0) {
+        uint32_t bytes = sectors * SECTOR_SIZE - within % SECTOR_SIZE;
+        *mapped = bytes < length ? bytes : length;
+        return data + within % SECTOR_SIZE;
+    }
+    
+    // No direct view of the device: lend out the handle's cluster buffer
+    uint8_t* buffer = fs_handle_load(handle, cluster, true);
+    if (!buffer) {
+        return NULL;
+    }
+    uint32_t bytes = g_fs.bytes_per_cluster - within;
+    *mapped = bytes < length ? bytes : length;
+    return buffer + within;
+}
+
 // Seek in a file
 bool fs_seek(fs_file_handle_t* handle, uint32_t position) {
     if (!handle || !handle->in_use || handle->is_directory) {
@@ -791,25 +2383,10 @@ bool fs_seek(fs_file_handle_t* handle, uint32_t position) {
         position = handle->file_size;
     }
     
-    // Reset to beginning and advance
-    handle->current_cluster = handle->first_cluster;
-    handle->cluster_offset = 0;
-    handle->position = 0;
-    
-    // Advance to target position
-    while (handle->position < position && handle->current_cluster >= 2 && handle->current_cluster < FAT32_EOC) {
-        uint32_t cluster_remaining = g_fs.bytes_per_cluster - handle->cluster_offset;
-        uint32_t to_advance = (position - handle->position < cluster_remaining) ? 
-                             position - handle->position : cluster_remaining;
-        
-        handle->position += to_advance;
-        handle->cluster_offset += to_advance;
-        
-        if (handle->cluster_offset >= g_fs.bytes_per_cluster) {
-            handle->current_cluster = fat32_read_fat_entry(handle->current_cluster);
-            handle->cluster_offset = 0;
-        }
-    }
+    // Jump straight to the cluster holding the target position
+    handle->current_cluster = fs_chain_cluster(handle, position / g_fs.bytes_per_cluster);
+    handle->cluster_offset = position % g_fs.bytes_per_cluster;
+    handle->position = position;
     
     return true;
 }
@@ -835,8 +2412,16 @@ bool fs_mkdir(const char* path) {
         return false;
     }
     
+    uint32_t parent_cluster;
+    char dirname[FS_MAX_NAME_LENGTH];
+    if (!fs_resolve(path, &parent_cluster, dirname) || !dirname[0] ||
+        strcmp(dirname, ".") == 0 || strcmp(dirname, "..") == 0) {
+        return false;
+    }
+    
     // Check if directory already exists
-    if (fs_exists(path)) {
+    fat32_dir_entry_t existing;
+    if (dir_lookup(parent_cluster, dirname, &existing, NULL)) {
         return false;
     }
     
@@ -847,12 +2432,10 @@ bool fs_mkdir(const char* path) {
     }
     
     // Clear the cluster
-    for (int i = 0; i < g_fs.bytes_per_cluster; i++) {
-        g_cluster_buffer[i] = 0;
-    }
+    memset(g_dir_buffer, 0, g_fs.bytes_per_cluster);
     
     // Create . and .. entries
-    fat32_dir_entry_t* entries = (fat32_dir_entry_t*)g_cluster_buffer;
+    fat32_dir_entry_t* entries = (fat32_dir_entry_t*)g_dir_buffer;
     
     // Create "." entry (current directory)
     for (int i = 0; i < 11; i++) {
@@ -864,30 +2447,33 @@ bool fs_mkdir(const char* path) {
     entries[0].first_cluster_low = new_cluster & 0xFFFF;
     entries[0].file_size = 0;
     
-    // Create ".." entry (parent directory)
+    // Create ".." entry (parent directory, 0 when it is the root)
+    uint32_t dotdot_cluster = (parent_cluster == g_fs.root_cluster) ? 0 : parent_cluster;
     for (int i = 0; i < 11; i++) {
         entries[1].name[i] = ' ';
     }
     entries[1].name[0] = '.';
     entries[1].name[1] = '.';
     entries[1].attributes = ATTR_DIRECTORY;
-    entries[1].first_cluster_high = (g_cwd.cluster >> 16) & 0xFFFF;
-    entries[1].first_cluster_low = g_cwd.cluster & 0xFFFF;
+    entries[1].first_cluster_high = (dotdot_cluster >> 16) & 0xFFFF;
+    entries[1].first_cluster_low = dotdot_cluster & 0xFFFF;
     entries[1].file_size = 0;
     
     // Write the directory cluster
-    if (!fat32_write_cluster(new_cluster, g_cluster_buffer)) {
+    if (!fat32_write_cluster(new_cluster, g_dir_buffer)) {
         fat32_free_cluster_chain(new_cluster);
+        fat32_flush_fat();
         return false;
     }
     
     // Create directory entry in parent directory
-    if (!create_dir_entry(g_cwd.cluster, path, new_cluster, 0, ATTR_DIRECTORY)) {
+    if (!create_dir_entry(parent_cluster, dirname, new_cluster, 0, ATTR_DIRECTORY, NULL)) {
         fat32_free_cluster_chain(new_cluster);
+        fat32_flush_fat();
         return false;
     }
     
-    return true;
+    return fat32_flush_fat();
 }
 
 // Delete file
@@ -897,62 +2483,63 @@ bool fs_delete(const char* path) {
     }
     
     // Find the file
-    uint32_t search_cluster = (path[0] == '/') ? g_fs.root_cluster : g_cwd.cluster;
-    const char* filename = (path[0] == '/') ? path + 1 : path;
+    uint32_t search_cluster;
+    char filename[FS_MAX_NAME_LENGTH];
+    if (!fs_resolve(path, &search_cluster, filename) || !filename[0]) {
+        return false;
+    }
     
-    if (!fat32_read_cluster(search_cluster, g_cluster_buffer)) {
+    fat32_dir_entry_t entry;
+    uint32_t slot;
+    if (!dir_lookup(search_cluster, filename, &entry, &slot)) {
+        return false; // File not found
+    }
+    
+    // Don't delete directories
+    if (entry.attributes & ATTR_DIRECTORY) {
         return false;
     }
     
-    fat32_dir_entry_t* entries = (fat32_dir_entry_t*)g_cluster_buffer;
-    int entries_per_cluster = g_fs.bytes_per_cluster / sizeof(fat32_dir_entry_t);
+    // An open handle would write its size back into the freed slot and
+    // keep writing to the freed clusters
+    if (fs_handle_on_entry(search_cluster, slot)) {
+        return false;
+    }
     
-    uint8_t fat_name[11];
-    fat32_name_to_83(filename, fat_name);
+    // Free the cluster chain
+    uint32_t first_cluster = dir_entry_cluster(&entry);
+    if (first_cluster >= 2) {
+        fat32_free_cluster_chain(first_cluster);
+    }
     
-    for (int i = 0; i < entries_per_cluster; i++) {
-        if (entries[i].name[0] == 0) {
-            break; // End of directory
-        }
-        
-        if (entries[i].name[0] == 0xE5) {
-            continue; // Deleted entry
-        }
-        
-        if (entries[i].attributes == ATTR_LONG_NAME) {
-            continue; // Skip long filename entries
+    bool removed = dir_entry_remove(search_cluster, slot);
+    return fat32_flush_fat() && removed;
+}
+
+// True when a directory holds nothing but . and ..
+static bool dir_is_empty(uint32_t dir_cluster) {
+    int entries_per_cluster = g_fs.bytes_per_cluster / sizeof(fat32_dir_entry_t);
+    int first = 2; // Skip . and ..
+    
+    for (uint32_t cluster = dir_cluster; cluster >= 2 && cluster < FAT32_EOC;
+         cluster = fat32_read_fat_entry(cluster)) {
+        if (!fat32_read_cluster(cluster, g_dir_buffer)) {
+            return false;
         }
         
-        // Compare names
-        bool match = true;
-        for (int j = 0; j < 11; j++) {
-            if (entries[i].name[j] != fat_name[j]) {
-                match = false;
-                break;
+        fat32_dir_entry_t* entries = (fat32_dir_entry_t*)g_dir_buffer;
+        for (int i = first; i < entries_per_cluster; i++) {
+            if (entries[i].name[0] == 0) {
+                return true;
             }
-        }
-        
-        if (match) {
-            // Don't delete directories
-            if (entries[i].attributes & ATTR_DIRECTORY) {
+            if (entries[i].name[0] != 0xE5) {
                 return false;
             }
-            
-            // Free the cluster chain
-            uint32_t first_cluster = (entries[i].first_cluster_high << 16) | entries[i].first_cluster_low;
-            if (first_cluster >= 2) {
-                fat32_free_cluster_chain(first_cluster);
-            }
-            
-            // Mark directory entry as deleted
-            entries[i].name[0] = 0xE5;
-            
-            // Write back the directory cluster
-            return fat32_write_cluster(search_cluster, g_cluster_buffer);
         }
+        first = 0;
     }
     
-    return false; // File not found
+    return true;
 }
 
 // Remove directory
@@ -962,80 +2549,39 @@ bool fs_rmdir(const char* path) {
     }
     
     // Find the directory
-    uint32_t search_cluster = (path[0] == '/') ? g_fs.root_cluster : g_cwd.cluster;
-    const char* dirname = (path[0] == '/') ? path + 1 : path;
-    
-    if (!fat32_read_cluster(search_cluster, g_cluster_buffer)) {
+    uint32_t search_cluster;
+    char dirname[FS_MAX_NAME_LENGTH];
+    if (!fs_resolve(path, &search_cluster, dirname) || !dirname[0]) {
         return false;
     }
     
-    fat32_dir_entry_t* entries = (fat32_dir_entry_t*)g_cluster_buffer;
-    int entries_per_cluster = g_fs.bytes_per_cluster / sizeof(fat32_dir_entry_t);
+    fat32_dir_entry_t entry;
+    uint32_t slot;
+    if (!dir_lookup(search_cluster, dirname, &entry, &slot)) {
+        return false; // Directory not found
+    }
     
-    uint8_t fat_name[11];
-    fat32_name_to_83(dirname, fat_name);
+    // Only delete directories
+    if (!(entry.attributes & ATTR_DIRECTORY)) {
+        return false;
+    }
     
-    for (int i = 0; i < entries_per_cluster; i++) {
-        if (entries[i].name[0] == 0) {
-            break; // End of directory
-        }
-        
-        if (entries[i].name[0] == 0xE5) {
-            continue; // Deleted entry
-        }
-        
-        if (entries[i].attributes == ATTR_LONG_NAME) {
-            continue; // Skip long filename entries
-        }
-        
-        // Compare names
-        bool match = true;
-        for (int j = 0; j < 11; j++) {
-            if (entries[i].name[j] != fat_name[j]) {
-                match = false;
-                break;
-            }
-        }
-        
-        if (match) {
-            // Only delete directories
-            if (!(entries[i].attributes & ATTR_DIRECTORY)) {
-                return false;
-            }
-            
-            // Check if directory is empty (only . and .. entries)
-            uint32_t dir_cluster = (entries[i].first_cluster_high << 16) | entries[i].first_cluster_low;
-            if (!fat32_read_cluster(dir_cluster, g_cluster_buffer)) {
-                return false;
-            }
-            
-            fat32_dir_entry_t* dir_entries = (fat32_dir_entry_t*)g_cluster_buffer;
-            for (int j = 2; j < entries_per_cluster; j++) { // Skip . and ..
-                if (dir_entries[j].name[0] != 0 && dir_entries[j].name[0] != 0xE5) {
-                    return false; // Directory not empty
-                }
-            }
-            
-            // Free the directory cluster
-            if (dir_cluster >= 2) {
-                fat32_free_cluster_chain(dir_cluster);
-            }
-            
-            // Read parent directory again (buffer was overwritten)
-            if (!fat32_read_cluster(search_cluster, g_cluster_buffer)) {
-                return false;
-            }
-            entries = (fat32_dir_entry_t*)g_cluster_buffer;
-            
-            // Mark directory entry as deleted
-            entries[i].name[0] = 0xE5;
-            
-            // Write back the parent directory cluster
-            return fat32_write_cluster(search_cluster, g_cluster_buffer);
-        }
+    // Check if directory is empty (only . and .. entries)
+    uint32_t dir_cluster = dir_entry_cluster(&entry);
+    if (dir_cluster < 2 || dir_cluster == g_fs.root_cluster || dir_cluster == g_cwd.cluster) {
+        return false;
+    }
+    if (!dir_is_empty(dir_cluster) || fs_handle_on_entry(search_cluster, slot)) {
+        return false;
     }
     
-    return false; // Directory not found
+    // Free the directory's clusters
+    dcache_drop_dir(dir_cluster);
+    dir_index_drop(dir_cluster);
+    fat32_free_cluster_chain(dir_cluster);
+    
+    bool removed = dir_entry_remove(search_cluster, slot);
+    return fat32_flush_fat() && removed;
 }
 
 // Rename file or directory
@@ -1044,58 +2590,90 @@ bool fs_rename(const char* old_path, const char* new_path) {
         return false;
     }
     
-    // Check if new name already exists
-    if (fs_exists(new_path)) {
+    uint32_t old_dir, new_dir;
+    char old_filename[FS_MAX_NAME_LENGTH];
+    char new_filename[FS_MAX_NAME_LENGTH];
+    if (!fs_resolve(old_path, &old_dir, old_filename) || !old_filename[0] ||
+        !fs_resolve(new_path, &new_dir, new_filename) || !new_filename[0]) {
         return false;
     }
     
-    // Find the old file
-    uint32_t search_cluster = (old_path[0] == '/') ? g_fs.root_cluster : g_cwd.cluster;
-    const char* old_filename = (old_path[0] == '/') ? old_path + 1 : old_path;
-    const char* new_filename = (new_path[0] == '/') ? new_path + 1 : new_path;
-    
-    if (!fat32_read_cluster(search_cluster, g_cluster_buffer)) {
+    // Check if new name already exists
+    fat32_dir_entry_t entry;
+    if (dir_lookup(new_dir, new_filename, &entry, NULL)) {
         return false;
     }
     
-    fat32_dir_entry_t* entries = (fat32_dir_entry_t*)g_cluster_buffer;
-    int entries_per_cluster = g_fs.bytes_per_cluster / sizeof(fat32_dir_entry_t);
-    
-    uint8_t old_fat_name[11];
-    fat32_name_to_83(old_filename, old_fat_name);
+    // Find the old file
+    uint32_t slot;
+    if (!dir_lookup(old_dir, old_filename, &entry, &slot)) {
+        return false; // File not found
+    }
+    uint32_t first_cluster = dir_entry_cluster(&entry);
     
-    for (int i = 0; i < entries_per_cluster; i++) {
-        if (entries[i].name[0] == 0) {
-            break; // End of directory
+    if (old_dir == new_dir) {
+        // Same directory: update the name in place
+        bcache_buf_t* buf;
+        fat32_dir_entry_t* target = dir_entry_get(old_dir, slot, &buf);
+        if (!target) {
+            return false;
         }
-        
-        if (entries[i].name[0] == 0xE5) {
-            continue; // Deleted entry
+        fs_dir_index_t* index = dir_index_peek(old_dir);
+        if (index) {
+            dir_index_remove(index, target->name, slot);
         }
-        
-        if (entries[i].attributes == ATTR_LONG_NAME) {
-            continue; // Skip long filename entries
+        dcache_store(old_dir, target->name, FS_DENTRY_NEGATIVE);
+        fat32_name_to_83(new_filename, target->name);
+        if (index && !dir_index_insert(index, target->name, slot)) {
+            dir_index_free(index);
         }
-        
-        // Compare names
-        bool match = true;
-        for (int j = 0; j < 11; j++) {
-            if (entries[i].name[j] != old_fat_name[j]) {
-                match = false;
-                break;
+        dcache_store(old_dir, target->name, slot);
+        fs_handles_move_entry(old_dir, slot, old_dir, slot, target->name);
+        bcache_mark_dirty(buf);
+        bcache_release(buf);
+        return true;
+    }
+    
+    // A directory cannot move below itself
+    if (entry.attributes & ATTR_DIRECTORY) {
+        for (uint32_t dir = new_dir; dir != g_fs.root_cluster; dir = dir_parent(dir)) {
+            if (dir == first_cluster) {
+                return false;
             }
         }
-        
-        if (match) {
-            // Update the filename
-            fat32_name_to_83(new_filename, entries[i].name);
-            
-            // Write back the directory cluster
-            return fat32_write_cluster(search_cluster, g_cluster_buffer);
+    }
+    
+    // Another directory: new entry there, then drop the old one
+    uint32_t new_slot;
+    if (!create_dir_entry(new_dir, new_filename, first_cluster, entry.file_size, entry.attributes, &new_slot)) {
+        fat32_flush_fat(); // The directory may have grown before it failed
+        return false;
+    }
+    if (!dir_entry_remove(old_dir, slot)) {
+        fat32_flush_fat();
+        return false;
+    }
+    
+    // The old slot can be handed out again; open handles follow the entry
+    uint8_t fat_name[11];
+    fat32_name_to_83(new_filename, fat_name);
+    fs_handles_move_entry(old_dir, slot, new_dir, new_slot, fat_name);
+    
+    // A moved directory's ".." has to follow it
+    if ((entry.attributes & ATTR_DIRECTORY) && first_cluster >= 2) {
+        bcache_buf_t* buf;
+        fat32_dir_entry_t* dotdot = dir_entry_get(first_cluster, 1, &buf);
+        if (dotdot) {
+            uint32_t parent = (new_dir == g_fs.root_cluster) ? 0 : new_dir;
+            dotdot->first_cluster_high = (parent >> 16) & 0xFFFF;
+            dotdot->first_cluster_low = parent & 0xFFFF;
+            bcache_mark_dirty(buf);
+            bcache_release(buf);
         }
     }
     
-    return false; // File not found
+    // Growing the target directory changed the FAT
+    return fat32_flush_fat();
 }
 
 // Check if filesystem is mounted
@@ -1120,22 +2698,17 @@ bool fs_list_directory(const char* path, void (*callback)(const char* name, bool
     }
     
     // Determine which directory to list
-    uint32_t cluster;
-    if (!path || strcmp(path, "") == 0 || strcmp(path, ".") == 0) {
-        cluster = g_cwd.cluster;
-    } else if (strcmp(path, "/") == 0) {
-        cluster = g_fs.root_cluster;
-    } else {
-        // For now, only support root and current directory
+    uint32_t cluster = g_cwd.cluster;
+    if (path && *path && !fs_resolve_dir(path, &cluster)) {
         return false;
     }
     
     while (cluster >= 2 && cluster < FAT32_EOC) {
-        if (!fat32_read_cluster(cluster, g_cluster_buffer)) {
+        if (!fat32_read_cluster(cluster, g_dir_buffer)) {
             return false;
         }
         
-        fat32_dir_entry_t* entries = (fat32_dir_entry_t*)g_cluster_buffer;
+        fat32_dir_entry_t* entries = (fat32_dir_entry_t*)g_dir_buffer;
         int entries_per_cluster = g_fs.bytes_per_cluster / sizeof(fat32_dir_entry_t);
         
         for (int i = 0; i < entries_per_cluster; i++) {
@@ -1175,17 +2748,68 @@ bool fs_list_directory(const char* path, void (*callback)(const char* name, bool
     return true;
 }
 
+// Copy a file
+//
+// The destination is allocated up front in as few runs as the volume
+// allows, then filled through the request queue: each step views one run
+// of the source in place with fs_map and writes it to the destination in
+// one direct write, and the keyboard and network are serviced between
+// steps. On the RAM disk the data is copied once, page to page, without
+// passing through any buffer. The FAT is written once by the allocation
+// and the directory entry once at close.
+bool fs_copy(const char* src_path, const char* dst_path) {
+    if (!g_fs.mounted || !src_path || !dst_path || fs_exists(dst_path)) {
+        return false;
+    }
+    
+    fs_file_handle_t* src = fs_open(src_path, "r");
+    if (!src) {
+        return false;
+    }
+    if (src->is_directory) {
+        fs_close(src);
+        return false;
+    }
+    
+    fs_file_handle_t* dst = fs_open(dst_path, "wd");
+    if (!dst) {
+        fs_close(src);
+        return false;
+    }
+    
+    uint32_t size = src->file_size;
+    fsq_request_t request = {0};
+    bool ok = fs_fallocate(dst, size) &&
+              fsq_copy(&request, src, dst, size, NULL, NULL) &&
+              fsq_wait(&request);
+    
+    ok = fs_flush(dst) && ok;
+    fs_close(dst);
+    fs_close(src);
+    
+    if (!ok) {
+        fs_delete(dst_path);
+    }
+    return ok;
+}
+
 // Check if file exists
 bool fs_exists(const char* path) {
     if (!g_fs.mounted || !path) {
         return false;
     }
     
-    uint32_t search_cluster = (path[0] == '/') ? g_fs.root_cluster : g_cwd.cluster;
-    const char* filename = (path[0] == '/') ? path + 1 : path;
+    uint32_t search_cluster;
+    char filename[FS_MAX_NAME_LENGTH];
+    if (!fs_resolve(path, &search_cluster, filename)) {
+        return false;
+    }
+    if (!filename[0] || strcmp(filename, ".") == 0 || strcmp(filename, "..") == 0) {
+        return true; // Names a directory on the way
+    }
     
-    fat32_dir_entry_t* entry = find_dir_entry(search_cluster, filename);
-    return entry != NULL;
+    fat32_dir_entry_t entry;
+    return dir_lookup(search_cluster, filename, &entry, NULL);
 }
 
 // Get file size
@@ -1194,24 +2818,38 @@ uint32_t fs_get_file_size(const char* path) {
         return 0;
     }
     
-    uint32_t search_cluster = (path[0] == '/') ? g_fs.root_cluster : g_cwd.cluster;
-    const char* filename = (path[0] == '/') ? path + 1 : path;
+    uint32_t search_cluster;
+    char filename[FS_MAX_NAME_LENGTH];
+    if (!fs_resolve(path, &search_cluster, filename) || !filename[0]) {
+        return 0;
+    }
     
-    fat32_dir_entry_t* entry = find_dir_entry(search_cluster, filename);
-    return entry ? entry->file_size : 0;
+    fat32_dir_entry_t entry;
+    return dir_lookup(search_cluster, filename, &entry, NULL) ? entry.file_size : 0;
 }
 
 // Unmount filesystem
 void fs_unmount(void) {
     if (g_fs.mounted) {
         // Close all open files
-        for (int i = 0; i < 32; i++) {
-            if (g_file_handles[i].in_use) {
-                fs_close(&g_file_handles[i]);
-            }
+        while (g_open_handles) {
+            fs_close(g_open_handles);
+        }
+        
+        if (!fat32_flush_fat()) {
+            terminal_writestring("FAT32: Failed to write the FAT\n");
+        }
+        if (!fat32_write_fsinfo()) {
+            terminal_writestring("FAT32: Failed to update FSInfo\n");
+        }
+        if (!bcache_sync(BCACHE_DEV_RAMDISK)) {
+            terminal_writestring("FAT32: Failed to write back cached sectors\n");
         }
         
         g_fs.mounted = false;
+        dcache_reset();
+        dir_index_reset();
+        fat32_release_fat();
         terminal_writestring("FAT32: Filesystem unmounted\n");
     }
 }
@@ -0,0 +1,217 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/fsqueue.h"
+#include "../include/filesystem.h"
+#include "../include/kernel.h"
+
+// Asynchronous filesystem requests
+//
+// A FIFO of caller-owned requests, worked off a step at a time by
+// fsq_poll() from the main loop. Opens and closes finish in one step;
+// reads, writes and copies move FSQ_SLICE bytes per step, so a long
+// transfer is spread over many trips round the loop and keyboard input
+// and network traffic are handled in between.
+
+static fsq_request_t* fsq_head = NULL;
+static fsq_request_t* fsq_tail = NULL;
+
+bool fsq_submit(fsq_request_t* request) {
+    if (!request || request->status == FSQ_QUEUED) {
+        return false;
+    }
+    if ((request->op == FSQ_READ || request->op == FSQ_WRITE) && !request->buffer && request->length) {
+        return false;
+    }
+    if (request->op == FSQ_COPY && (!request->handle || !request->target)) {
+        return false;
+    }
+
+    request->status = FSQ_QUEUED;
+    request->done = 0;
+    request->next = NULL;
+
+    if (fsq_tail) {
+        fsq_tail->next = request;
+    } else {
+        fsq_head = request;
+    }
+    fsq_tail = request;
+    return true;
+}
+
+static bool fsq_prepare(fsq_request_t* request, fsq_op_t op, fs_file_handle_t* handle,
+                        fsq_callback_t callback, void* context) {
+    if (!request || request->status == FSQ_QUEUED) {
+        return false;
+    }
+
+    request->op = op;
+    request->path = NULL;
+    request->mode = NULL;
+    request->handle = handle;
+    request->target = NULL;
+    request->buffer = NULL;
+    request->length = 0;
+    request->callback = callback;
+    request->context = context;
+    return true;
+}
+
+bool fsq_open(fsq_request_t* request, const char* path, const char* mode,
+              fsq_callback_t callback, void* context) {
+    if (!path || !mode || !fsq_prepare(request, FSQ_OPEN, NULL, callback, context)) {
+        return false;
+    }
+    request->path = path;
+    request->mode = mode;
+    return fsq_submit(request);
+}
+
+bool fsq_read(fsq_request_t* request, fs_file_handle_t* handle, void* buffer, size_t length,
+              fsq_callback_t callback, void* context) {
+    if (!fsq_prepare(request, FSQ_READ, handle, callback, context)) {
+        return false;
+    }
+    request->buffer = buffer;
+    request->length = length;
+    return fsq_submit(request);
+}
+
+bool fsq_write(fsq_request_t* request, fs_file_handle_t* handle, const void* buffer, size_t length,
+               fsq_callback_t callback, void* context) {
+    if (!fsq_prepare(request, FSQ_WRITE, handle, callback, context)) {
+        return false;
+    }
+    request->buffer = (void*)buffer;
+    request->length = length;
+    return fsq_submit(request);
+}
+
+bool fsq_close(fsq_request_t* request, fs_file_handle_t* handle,
+               fsq_callback_t callback, void* context) {
+    if (!fsq_prepare(request, FSQ_CLOSE, handle, callback, context)) {
+        return false;
+    }
+    return fsq_submit(request);
+}
+
+bool fsq_copy(fsq_request_t* request, fs_file_handle_t* src, fs_file_handle_t* dst, size_t length,
+              fsq_callback_t callback, void* context) {
+    if (!fsq_prepare(request, FSQ_COPY, src, callback, context)) {
+        return false;
+    }
+    request->target = dst;
+    request->length = length;
+    return fsq_submit(request);
+}
+
+// Take the head request off the queue and report it
+static void fsq_complete(fsq_request_t* request, bool ok) {
+    fsq_head = request->next;
+    if (!fsq_head) {
+        fsq_tail = NULL;
+    }
+    request->next = NULL;
+    request->status = ok ? FSQ_DONE : FSQ_FAILED;
+
+    if (request->callback) {
+        request->callback(request);
+    }
+}
+
+// One slice of a read or write. Returns true once the request is finished.
+static bool fsq_transfer(fsq_request_t* request, bool* ok) {
+    size_t step = request->length - request->done;
+    if (step > FSQ_SLICE) {
+        step = FSQ_SLICE;
+    }
+
+    uint8_t* data = (uint8_t*)request->buffer + request->done;
+    size_t moved = (request->op == FSQ_READ) ? fs_read(request->handle, data, step)
+                                             : fs_write(request->handle, data, step);
+    request->done += moved;
+
+    if (moved < step) {
+        // End of file is a short read, not an error
+        *ok = request->op == FSQ_READ;
+        return true;
+    }
+    *ok = true;
+    return request->done == request->length;
+}
+
+// One mapped run of a copy. Returns true once the request is finished.
+static bool fsq_copy_run(fsq_request_t* request, bool* ok) {
+    size_t step = request->length - request->done;
+    if (step > FSQ_SLICE) {
+        step = FSQ_SLICE;
+    }
+
+    *ok = true;
+    if (step == 0) {
+        return true;
+    }
+
+    uint32_t mapped;
+    const void* data = fs_map(request->handle, request->done, step, &mapped);
+    if (!data || fs_write(request->target, data, mapped) != mapped) {
+        *ok = false;
+        return true;
+    }
+    request->done += mapped;
+    return request->done == request->length;
+}
+
+bool fsq_poll(void) {
+    fsq_request_t* request = fsq_head;
+    if (!request) {
+        return false;
+    }
+
+    bool ok = false;
+    bool finished = true;
+
+    switch (request->op) {
+        case FSQ_OPEN:
+            request->handle = fs_open(request->path, request->mode);
+            ok = request->handle != NULL;
+            break;
+        case FSQ_CLOSE:
+            if (request->handle) {
+                ok = fs_flush(request->handle);
+                fs_close(request->handle);
+            }
+            break;
+        case FSQ_READ:
+        case FSQ_WRITE:
+            if (request->handle) {
+                finished = fsq_transfer(request, &ok);
+            }
+            break;
+        case FSQ_COPY:
+            finished = fsq_copy_run(request, &ok);
+            break;
+    }
+
+    if (finished) {
+        fsq_complete(request, ok);
+    }
+    return fsq_head != NULL;
+}
+
+bool fsq_is_done(const fsq_request_t* request) {
+    return request && (request->status == FSQ_DONE || request->status == FSQ_FAILED);
+}
+
+bool fsq_wait(fsq_request_t* request) {
+    if (!request || request->status == FSQ_IDLE) {
+        return false;
+    }
+
+    while (request->status == FSQ_QUEUED) {
+        fsq_poll();
+        kernel_poll_devices();
+    }
+    return request->status == FSQ_DONE;
+}
@@ -11,36 +11,14 @@
 #include "../include/network.h"
 #include "../include/dhcp.h"
 #include "../include/kernel.h"
-
-// Multiboot header definitions
-#define MULTIBOOT_MAGIC 0x1BADB002
-#define MULTIBOOT_FLAGS 0x00000003
-#define MULTIBOOT_CHECKSUM -(MULTIBOOT_MAGIC + MULTIBOOT_FLAGS)
-
-// Multiboot structure definition
-typedef struct {
-    uint32_t flags;
-    uint32_t mem_lower;
-    uint32_t mem_upper;
-    uint32_t boot_device;
-    uint32_t cmdline;
-    uint32_t mods_count;
-    uint32_t mods_addr;
-    uint32_t syms[4];
-    uint32_t mmap_length;
-    uint32_t mmap_addr;
-    uint32_t drives_length;
-    uint32_t drives_addr;
-    uint32_t config_table;
-    uint32_t boot_loader_name;
-    uint32_t apm_table;
-    uint32_t vbe_control_info;
-    uint32_t vbe_mode_info;
-    uint16_t vbe_mode;
-    uint16_t vbe_interface_seg;
-    uint16_t vbe_interface_off;
-    uint16_t vbe_interface_len;
-} multiboot_info_t;
+#include "../include/multiboot.h"
+#include "../include/memory.h"
+#include "../include/pmm.h"
+#include "../include/dma.h"
+#include "../include/vmm.h"
+#include "../include/cpu.h"
+#include "../include/bcache.h"
+#include "../include/fsqueue.h"
 
 // Declare the multiboot_info variable that will be used by system.c
 multiboot_info_t* multiboot_info = NULL;
@@ -95,13 +73,8 @@ void terminal_putentryat(char c, uint8_t color, size_t x, size_t y)
 
 void terminal_scroll(void) {
     // Move all lines up by one
-    for (size_t y = 0; y < VGA_HEIGHT - 1; y++) {
-        for (size_t x = 0; x < VGA_WIDTH; x++) {
-            size_t current_index = y * VGA_WIDTH + x;
-            size_t next_index = (y + 1) * VGA_WIDTH + x;
-            terminal_buffer[current_index] = terminal_buffer[next_index];
-        }
-    }
+    memmove(terminal_buffer, terminal_buffer + VGA_WIDTH,
+            (VGA_HEIGHT - 1) * VGA_WIDTH * sizeof(uint16_t));
     
     // Clear the last line
     for (size_t x = 0; x < VGA_WIDTH; x++) {
@@ -224,7 +197,7 @@ void process_command(const char* cmd) {
         return;
     }
     
-    if (strncmp(cmd, "help", cmd_length) == 0 && cmd_length == 4) {
+    if (cmd_length == 4 && strncmp(cmd, "help", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_help(args);
@@ -233,14 +206,14 @@ void process_command(const char* cmd) {
     }
 
     // Check for "clear" command
-    if (strncmp(cmd, "clear", cmd_length) == 0 && cmd_length == 5) {
+    if (cmd_length == 5 && strncmp(cmd, "clear", cmd_length) == 0) {
         terminal_clear();
         print_prompt();
         return;
     }
     
     // Check for "echo" command
-    if (strncmp(cmd, "echo", cmd_length) == 0 && cmd_length == 4) {
+    if (cmd_length == 4 && strncmp(cmd, "echo", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_echo(args);
@@ -249,7 +222,7 @@ void process_command(const char* cmd) {
     }
     
     // Check for "system" command
-    if (strncmp(cmd, "system", cmd_length) == 0 && cmd_length == 6) {
+    if (cmd_length == 6 && strncmp(cmd, "system", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_system(args);
@@ -258,7 +231,7 @@ void process_command(const char* cmd) {
     }
     
     // Filesystem commands
-    if (strncmp(cmd, "ls", cmd_length) == 0 && cmd_length == 2) {
+    if (cmd_length == 2 && strncmp(cmd, "ls", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_ls(args);
@@ -266,7 +239,7 @@ void process_command(const char* cmd) {
         return;
     }
     
-    if (strncmp(cmd, "cd", cmd_length) == 0 && cmd_length == 2) {
+    if (cmd_length == 2 && strncmp(cmd, "cd", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_cd(args);
@@ -274,7 +247,7 @@ void process_command(const char* cmd) {
         return;
     }
     
-    if (strncmp(cmd, "mkdir", cmd_length) == 0 && cmd_length == 5) {
+    if (cmd_length == 5 && strncmp(cmd, "mkdir", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_mkdir(args);
@@ -282,7 +255,7 @@ void process_command(const char* cmd) {
         return;
     }
 
-    if (strncmp(cmd, "read", cmd_length) == 0 && cmd_length == 4) {
+    if (cmd_length == 4 && strncmp(cmd, "read", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_read(args);
@@ -291,7 +264,7 @@ void process_command(const char* cmd) {
     }
 
         // New file operation commands
-    if (strncmp(cmd, "write", cmd_length) == 0 && cmd_length == 5) {
+    if (cmd_length == 5 && strncmp(cmd, "write", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_write(args);
@@ -299,7 +272,7 @@ void process_command(const char* cmd) {
         return;
     }
 
-    if (strncmp(cmd, "touch", cmd_length) == 0 && cmd_length == 5) {
+    if (cmd_length == 5 && strncmp(cmd, "touch", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_touch(args);
@@ -307,7 +280,7 @@ void process_command(const char* cmd) {
         return;
     }
 
-    if (strncmp(cmd, "cp", cmd_length) == 0 && cmd_length == 2) {
+    if (cmd_length == 2 && strncmp(cmd, "cp", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_cp(args);
@@ -315,7 +288,7 @@ void process_command(const char* cmd) {
         return;
     }
 
-    if (strncmp(cmd, "rm", cmd_length) == 0 && cmd_length == 2) {
+    if (cmd_length == 2 && strncmp(cmd, "rm", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_rm(args);
@@ -323,7 +296,7 @@ void process_command(const char* cmd) {
         return;
     }
 
-    if (strncmp(cmd, "mv", cmd_length) == 0 && cmd_length == 2) {
+    if (cmd_length == 2 && strncmp(cmd, "mv", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_mv(args);
@@ -331,7 +304,7 @@ void process_command(const char* cmd) {
         return;
     }
 
-     if (strncmp(cmd, "tee", cmd_length) == 0 && cmd_length == 3) {
+     if (cmd_length == 3 && strncmp(cmd, "tee", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_tee(args);
@@ -339,7 +312,7 @@ void process_command(const char* cmd) {
         return;
     }
 
-    if (strncmp(cmd, "wc", cmd_length) == 0 && cmd_length == 2) {
+    if (cmd_length == 2 && strncmp(cmd, "wc", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_wc(args);
@@ -348,7 +321,7 @@ void process_command(const char* cmd) {
     }
 
     // Alternative command for reading files
-    if (strncmp(cmd, "cat", cmd_length) == 0 && cmd_length == 3) {
+    if (cmd_length == 3 && strncmp(cmd, "cat", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_read(args); // Use the same function as read
@@ -357,14 +330,14 @@ void process_command(const char* cmd) {
     }
 
     // Print working directory
-    if (strncmp(cmd, "pwd", cmd_length) == 0 && cmd_length == 3) {
+    if (cmd_length == 3 && strncmp(cmd, "pwd", cmd_length) == 0) {
         cmd_pwd();
         print_prompt();
         return;
     }
 
     // Check for "mount" command
-    if (strncmp(cmd, "mount", cmd_length) == 0 && cmd_length == 5) {
+    if (cmd_length == 5 && strncmp(cmd, "mount", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_mount(args);
@@ -373,7 +346,7 @@ void process_command(const char* cmd) {
     }
 
     // Check for "unmount" command
-    if (strncmp(cmd, "unmount", cmd_length) == 0 && cmd_length == 7) {
+    if (cmd_length == 7 && strncmp(cmd, "unmount", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_unmount(args);
@@ -382,7 +355,7 @@ void process_command(const char* cmd) {
     }
     
     // Filesystem info command
-    if (strncmp(cmd, "fsinfo", cmd_length) == 0 && cmd_length == 6) {
+    if (cmd_length == 6 && strncmp(cmd, "fsinfo", cmd_length) == 0) {
         if (!fs_is_mounted()) {
             terminal_writestring("Filesystem not mounted\n");
         } else {
@@ -434,13 +407,59 @@ void process_command(const char* cmd) {
             size_str[pos] = '\0';
             terminal_writestring(size_str);
             terminal_writestring(" MB\n");
+            
+            // Buffer cache activity
+            bcache_stats_t cache;
+            bcache_get_stats(&cache);
+            uint32_t lookups = cache.hits + cache.misses;
+            uint32_t hit_rate = 0;
+            if (lookups > 0) {
+                hit_rate = (cache.hits < 0xFFFFFFFF / 100) ? cache.hits * 100 / lookups
+                                                            : cache.hits / (lookups / 100);
+            }
+            
+            terminal_writestring("Buffer cache: ");
+            itoa(cache.valid, size_str, 10);
+            terminal_writestring(size_str);
+            terminal_writestring("/");
+            itoa(cache.buffers, size_str, 10);
+            terminal_writestring(size_str);
+            terminal_writestring(" sectors, ");
+            itoa(cache.dirty, size_str, 10);
+            terminal_writestring(size_str);
+            terminal_writestring(" dirty\n");
+            
+            terminal_writestring("Cache hits: ");
+            itoa(cache.hits, size_str, 10);
+            terminal_writestring(size_str);
+            terminal_writestring(", misses: ");
+            itoa(cache.misses, size_str, 10);
+            terminal_writestring(size_str);
+            terminal_writestring(" (");
+            itoa(hit_rate, size_str, 10);
+            terminal_writestring(size_str);
+            terminal_writestring("% hit rate)\n");
+            
+            terminal_writestring("Device reads: ");
+            itoa(cache.device_reads, size_str, 10);
+            terminal_writestring(size_str);
+            terminal_writestring(", writes: ");
+            itoa(cache.device_writes, size_str, 10);
+            terminal_writestring(size_str);
+            terminal_writestring(", write-backs: ");
+            itoa(cache.writebacks, size_str, 10);
+            terminal_writestring(size_str);
+            terminal_writestring(", read ahead: ");
+            itoa(cache.prefetched, size_str, 10);
+            terminal_writestring(size_str);
+            terminal_writestring("\n");
         }
         print_prompt();
         return;
     }
 
     // Text editor command
-    if (strncmp(cmd, "pia", cmd_length) == 0 && cmd_length == 3) {
+    if (cmd_length == 3 && strncmp(cmd, "pia", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_pia(args);
@@ -449,7 +468,7 @@ void process_command(const char* cmd) {
     }
 
     // Network commands
-    if (strncmp(cmd, "ipconfig", cmd_length) == 0 && cmd_length == 8) {
+    if (cmd_length == 8 && strncmp(cmd, "ipconfig", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_ipconfig(args);
@@ -457,7 +476,7 @@ void process_command(const char* cmd) {
         return;
     }
 
-    if (strncmp(cmd, "ping", cmd_length) == 0 && cmd_length == 4) {
+    if (cmd_length == 4 && strncmp(cmd, "ping", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_ping(args);
@@ -465,7 +484,7 @@ void process_command(const char* cmd) {
         return;
     }
 
-    if (strncmp(cmd, "dhcp", cmd_length) == 0 && cmd_length == 4) {
+    if (cmd_length == 4 && strncmp(cmd, "dhcp", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_dhcp(args);
@@ -473,7 +492,7 @@ void process_command(const char* cmd) {
         return;
     }
     
-    if (strncmp(cmd, "install", cmd_length) == 0 && cmd_length == 7) {
+    if (cmd_length == 7 && strncmp(cmd, "install", cmd_length) == 0) {
         const char* args = cmd_end;
         while (*args == ' ') args++;
         cmd_install(args);
@@ -481,7 +500,7 @@ void process_command(const char* cmd) {
         return;
     }
 
-    if (strncmp(cmd, "netstat", cmd_length) == 0 && cmd_length == 7) {
+    if (cmd_length == 7 && strncmp(cmd, "netstat", cmd_length) == 0) {
         cmd_netstat("");
         print_prompt();
         return;
@@ -494,6 +513,23 @@ void process_command(const char* cmd) {
     print_prompt();
 }
 
+void kernel_poll_devices(void) {
+    static uint32_t dhcp_tick_counter = 0;
+    
+    // Poll keyboard for input
+    keyboard_poll();
+    
+    // Process network packets
+    network_process_packets();
+    
+    // DHCP tick (approximately every second)
+    dhcp_tick_counter++;
+    if (dhcp_tick_counter >= 100000) { // Adjust this value based on your loop speed
+        dhcp_tick();
+        dhcp_tick_counter = 0;
+    }
+}
+
 void wait(uint32_t milliseconds) {
     // Simple CPU cycle-based delay
     volatile uint32_t delay = milliseconds * 500000; // Adjust multiplier as needed
@@ -525,6 +561,11 @@ void kernel_main(uint32_t magic, multiboot_info_t* mbd) {
 
     // Initialize memory system first
     terminal_writestring("Initializing Memory System...\n");
+    cpu_init();
+    string_init();
+    pmm_init(magic == MULTIBOOT_BOOTLOADER_MAGIC ? mbd : NULL);
+    vmm_init(magic == MULTIBOOT_BOOTLOADER_MAGIC ? mbd : NULL);
+    dma_init();
     memory_init();
 
     terminal_writestring("Initializing disk subsystem...\n");
@@ -614,25 +655,15 @@ void kernel_main(uint32_t magic, multiboot_info_t* mbd) {
     command_length = 0;
     current_command[0] = '\0';
     
-    static uint32_t dhcp_tick_counter = 0;
-
     // Main input loop
     while (1) {
-        // Poll keyboard for input
-        keyboard_poll();
+        kernel_poll_devices();
         
         // Process any available keys
         char key = keyboard_get_key();
-
-        // Process network packets
-        network_process_packets();
         
-        // DHCP tick (approximately every second)
-        dhcp_tick_counter++;
-        if (dhcp_tick_counter >= 100000) { // Adjust this value based on your loop speed
-            dhcp_tick();
-            dhcp_tick_counter = 0;
-        }
+        // Move queued filesystem requests along
+        fsq_poll();
         
         if (key != 0) {
             // Handle special keys or control characters
@@ -1,73 +1,603 @@
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include "../include/memory.h"
+#include "../include/pmm.h"
+#include "../include/vmm.h"
+#include "../include/string.h"
 
-// Simple memory allocator using a static buffer
-#define HEAP_SIZE (1024 * 1024)  // 1MB heap
-static uint8_t heap[HEAP_SIZE];
-static size_t heap_offset = 0;
+// Kernel heap
+//
+// Small requests (up to HEAP_SMALL_MAX bytes) are served from per-size-class
+// free lists carved out of whole frames, so allocation and free are O(1).
+// Larger requests come from arenas of contiguous frames managed with boundary
+// tags (header + footer), segregated free bins and immediate coalescing.
+// Every block starts with the same 8-byte header so free() can tell them apart.
+//
+// The header also records which call site allocated the block, so usage can
+// be attributed per caller (see heap_get_stats/heap_get_sites).
 
-void* kmalloc(size_t size) {
-    // Align to 4-byte boundary
-    size = (size + 3) & ~3;
-    
-    if (heap_offset + size > HEAP_SIZE) {
+#define HEAP_ALIGN        8
+#define HEAP_MAGIC        0x5AFE0000
+#define HEAP_MAGIC_MASK   0xFFFF0000
+#define HEAP_SITE_SHIFT   8
+#define HEAP_SITE_MASK    0x0000FF00
+#define HEAP_CLASS_MASK   0x000000FF
+
+// Flags kept in the low bits of the block size
+#define HEAP_FLAG_USED    0x1
+#define HEAP_FLAG_SMALL   0x2
+#define HEAP_FLAG_MASK    0x7
+
+#define HEAP_SMALL_MAX    2040  // Largest payload served by a size class
+#define HEAP_SMALL_REFILL 8     // Minimum chunks carved per refill
+
+#define HEAP_ARENA_MIN    (64 * 1024)
+#define HEAP_BIN_COUNT    20
+
+typedef struct {
+    uint32_t size;  // Block size including header/footer, plus flags
+    uint32_t info;  // HEAP_MAGIC | call site << 8 | size class index
+} heap_header_t;
+
+typedef uint32_t heap_footer_t;
+
+// Free large blocks keep their list links in the payload
+typedef struct heap_free_block {
+    heap_header_t header;
+    struct heap_free_block* next;
+    struct heap_free_block* prev;
+} heap_free_block_t;
+
+// Free small chunks only need a single link
+typedef struct heap_chunk {
+    heap_header_t header;
+    struct heap_chunk* next;
+} heap_chunk_t;
+
+#define HEAP_LARGE_OVERHEAD (sizeof(heap_header_t) + sizeof(heap_footer_t))
+#define HEAP_LARGE_MIN      ((sizeof(heap_free_block_t) + sizeof(heap_footer_t) + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1))
+
+// Chunk sizes (header included) of the small size classes
+static const uint16_t heap_class_sizes[] = {
+    16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048
+};
+#define HEAP_CLASS_COUNT (sizeof(heap_class_sizes) / sizeof(heap_class_sizes[0]))
+
+_Static_assert(HEAP_CLASS_COUNT == HEAP_SIZE_CLASSES, "HEAP_SIZE_CLASSES out of date");
+
+static heap_chunk_t* heap_class_free[HEAP_CLASS_COUNT];
+static uint8_t heap_class_index[HEAP_SMALL_MAX / HEAP_ALIGN + 1];
+static heap_free_block_t* heap_bins[HEAP_BIN_COUNT];
+static uint32_t heap_arena_count = 0;
+static bool heap_ready = false;
+
+// Instrumentation
+static heap_stats_t heap_stats;
+static heap_site_stats_t heap_sites[HEAP_MAX_SITES]; // Slot 0 collects overflow
+static uint32_t heap_class_total[HEAP_CLASS_COUNT];
+
+static inline uint32_t heap_rdtsc(void) {
+    uint32_t low, high;
+    __asm__ volatile ("rdtsc" : "=a"(low), "=d"(high));
+    return low;
+}
+
+// Find or claim the site slot for a caller (open addressing, slot 0 reserved)
+static uint32_t heap_site_index(uint32_t caller) {
+    uint32_t slot = ((caller >> 2) * 2654435761u) % (HEAP_MAX_SITES - 1) + 1;
+    for (uint32_t probe = 0; probe < HEAP_MAX_SITES - 1; probe++) {
+        if (heap_sites[slot].caller == caller) {
+            return slot;
+        }
+        if (heap_sites[slot].caller == 0) {
+            heap_sites[slot].caller = caller;
+            return slot;
+        }
+        slot = slot % (HEAP_MAX_SITES - 1) + 1;
+    }
+    return 0;
+}
+
+static inline uint32_t heap_site_of(const heap_header_t* header) {
+    return (header->info & HEAP_SITE_MASK) >> HEAP_SITE_SHIFT;
+}
+
+static inline void heap_set_site(heap_header_t* header, uint32_t site) {
+    header->info = (header->info & ~HEAP_SITE_MASK) | (site << HEAP_SITE_SHIFT);
+}
+
+static void heap_account(heap_header_t* header, uint32_t old_size, uint32_t new_size) {
+    heap_site_stats_t* site = &heap_sites[heap_site_of(header)];
+
+    heap_stats.bytes_in_use += new_size - old_size;
+    site->bytes_in_use += new_size - old_size;
+
+    if (heap_stats.bytes_in_use > heap_stats.peak_bytes_in_use) {
+        heap_stats.peak_bytes_in_use = heap_stats.bytes_in_use;
+    }
+    if (site->bytes_in_use > site->peak_bytes) {
+        site->peak_bytes = site->bytes_in_use;
+    }
+}
+
+static inline uint32_t heap_block_size(const heap_header_t* header) {
+    return header->size & ~HEAP_FLAG_MASK;
+}
+
+static inline heap_footer_t* heap_footer(heap_header_t* header) {
+    return (heap_footer_t*)((uint8_t*)header + heap_block_size(header) - sizeof(heap_footer_t));
+}
+
+static inline heap_header_t* heap_next_block(heap_header_t* header) {
+    return (heap_header_t*)((uint8_t*)header + heap_block_size(header));
+}
+
+static inline heap_header_t* heap_header_of(void* ptr) {
+    return (heap_header_t*)((uint8_t*)ptr - sizeof(heap_header_t));
+}
+
+static inline void heap_set_large(heap_header_t* header, uint32_t size, uint32_t flags) {
+    header->size = size | flags;
+    header->info = HEAP_MAGIC;
+    *heap_footer(header) = size | flags;
+}
+
+static int heap_bin_index(uint32_t size) {
+    int bin = 31 - __builtin_clz(size) - 5; // 32..63 bytes -> bin 0
+    if (bin < 0) {
+        bin = 0;
+    }
+    if (bin >= HEAP_BIN_COUNT) {
+        bin = HEAP_BIN_COUNT - 1;
+    }
+    return bin;
+}
+
+static void heap_bin_insert(heap_free_block_t* block) {
+    int bin = heap_bin_index(heap_block_size(&block->header));
+    block->prev = NULL;
+    block->next = heap_bins[bin];
+    if (heap_bins[bin]) {
+        heap_bins[bin]->prev = block;
+    }
+    heap_bins[bin] = block;
+}
+
+static void heap_bin_remove(heap_free_block_t* block) {
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        heap_bins[heap_bin_index(heap_block_size(&block->header))] = block->next;
+    }
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+}
+
+// Grab frames for the heap and identity map them
+static void* heap_alloc_pages(uint32_t pages) {
+    uint32_t phys = pmm_alloc_frames(pages, 1, 0);
+    if (!phys) {
+        return NULL;
+    }
+    if (!vmm_map(phys, phys, pages, VMM_PAGE_WRITE)) {
+        pmm_free_frames(phys, pages);
+        return NULL;
+    }
+    heap_stats.bytes_reserved += pages * PMM_FRAME_SIZE;
+    return (void*)phys;
+}
+
+// Create a new arena with room for at least 'size' bytes of blocks.
+// Layout: [pad][prologue footer][blocks ...][epilogue header]
+static heap_free_block_t* heap_add_arena(uint32_t size) {
+    uint32_t arena_size = size + 2 * sizeof(heap_header_t);
+    if (arena_size < HEAP_ARENA_MIN) {
+        arena_size = HEAP_ARENA_MIN;
+    }
+    arena_size = (arena_size + PMM_FRAME_SIZE - 1) & ~(PMM_FRAME_SIZE - 1);
+
+    uint8_t* arena = heap_alloc_pages(arena_size / PMM_FRAME_SIZE);
+    if (!arena) {
+        return NULL;
+    }
+
+    // Prologue footer marks "previous block in use" for the first block
+    *(heap_footer_t*)(arena + sizeof(heap_header_t) - sizeof(heap_footer_t)) = HEAP_FLAG_USED;
+
+    // Epilogue header marks "next block in use" for the last block
+    heap_header_t* epilogue = (heap_header_t*)(arena + arena_size - sizeof(heap_header_t));
+    epilogue->size = HEAP_FLAG_USED;
+    epilogue->info = HEAP_MAGIC;
+
+    heap_free_block_t* block = (heap_free_block_t*)(arena + sizeof(heap_header_t));
+    heap_set_large(&block->header, arena_size - 2 * sizeof(heap_header_t), 0);
+    heap_bin_insert(block);
+    heap_arena_count++;
+
+    return block;
+}
+
+// Give a fully free arena back to the frame allocator
+static bool heap_try_release_arena(heap_header_t* header) {
+    heap_footer_t prev_footer = *(heap_footer_t*)((uint8_t*)header - sizeof(heap_footer_t));
+    heap_header_t* next = heap_next_block(header);
+
+    bool starts_arena = (prev_footer & ~HEAP_FLAG_MASK) == 0;
+    bool ends_arena = heap_block_size(next) == 0;
+    if (!starts_arena || !ends_arena || heap_arena_count <= 1) {
+        return false;
+    }
+
+    uint8_t* arena = (uint8_t*)header - sizeof(heap_header_t);
+    uint32_t arena_size = heap_block_size(header) + 2 * sizeof(heap_header_t);
+    vmm_unmap((uint32_t)arena, arena_size / PMM_FRAME_SIZE);
+    pmm_free_frames((uint32_t)arena, arena_size / PMM_FRAME_SIZE);
+    heap_stats.bytes_reserved -= arena_size;
+    heap_arena_count--;
+    return true;
+}
+
+// Split a used large block so that it is exactly 'size' bytes, returning
+// the tail to the free bins
+static void heap_split(heap_header_t* header, uint32_t size) {
+    uint32_t total = heap_block_size(header);
+    if (total - size < HEAP_LARGE_MIN) {
+        return;
+    }
+
+    uint32_t site = heap_site_of(header);
+    heap_set_large(header, size, HEAP_FLAG_USED);
+    heap_set_site(header, site);
+
+    heap_free_block_t* rest = (heap_free_block_t*)((uint8_t*)header + size);
+    heap_set_large(&rest->header, total - size, 0);
+
+    // The remainder may border another free block
+    heap_header_t* next = heap_next_block(&rest->header);
+    if (!(next->size & HEAP_FLAG_USED)) {
+        heap_bin_remove((heap_free_block_t*)next);
+        heap_set_large(&rest->header, heap_block_size(&rest->header) + heap_block_size(next), 0);
+    }
+    heap_bin_insert(rest);
+}
+
+static void* heap_alloc_large(size_t size) {
+    uint32_t needed = (size + HEAP_LARGE_OVERHEAD + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+    if (needed < HEAP_LARGE_MIN) {
+        needed = HEAP_LARGE_MIN;
+    }
+
+    heap_free_block_t* found = NULL;
+
+    // First fit within the matching bin, then the head of any larger bin
+    int bin = heap_bin_index(needed);
+    for (heap_free_block_t* block = heap_bins[bin]; block; block = block->next) {
+        if (heap_block_size(&block->header) >= needed) {
+            found = block;
+            break;
+        }
+    }
+    for (int i = bin + 1; !found && i < HEAP_BIN_COUNT; i++) {
+        for (heap_free_block_t* block = heap_bins[i]; block; block = block->next) {
+            if (heap_block_size(&block->header) >= needed) {
+                found = block;
+                break;
+            }
+        }
+    }
+
+    if (!found) {
+        found = heap_add_arena(needed);
+        if (!found) {
+            return NULL; // Out of memory
+        }
+    }
+
+    heap_bin_remove(found);
+    heap_set_large(&found->header, heap_block_size(&found->header), HEAP_FLAG_USED);
+    heap_split(&found->header, needed);
+
+    return (uint8_t*)found + sizeof(heap_header_t);
+}
+
+static void heap_free_large(heap_header_t* header) {
+    uint32_t size = heap_block_size(header);
+
+    // Coalesce with the previous block
+    heap_footer_t prev_footer = *(heap_footer_t*)((uint8_t*)header - sizeof(heap_footer_t));
+    if (!(prev_footer & HEAP_FLAG_USED)) {
+        heap_header_t* prev = (heap_header_t*)((uint8_t*)header - (prev_footer & ~HEAP_FLAG_MASK));
+        heap_bin_remove((heap_free_block_t*)prev);
+        size += heap_block_size(prev);
+        header = prev;
+    }
+
+    // Coalesce with the next block
+    heap_header_t* next = (heap_header_t*)((uint8_t*)header + size);
+    if (!(next->size & HEAP_FLAG_USED)) {
+        heap_bin_remove((heap_free_block_t*)next);
+        size += heap_block_size(next);
+    }
+
+    heap_set_large(header, size, 0);
+
+    if (!heap_try_release_arena(header)) {
+        heap_bin_insert((heap_free_block_t*)header);
+    }
+}
+
+// Carve a fresh run of frames into chunks for one size class
+static bool heap_refill_class(uint32_t class_index) {
+    uint32_t chunk_size = heap_class_sizes[class_index];
+    uint32_t pages = (chunk_size * HEAP_SMALL_REFILL + PMM_FRAME_SIZE - 1) / PMM_FRAME_SIZE;
+
+    uint8_t* run = heap_alloc_pages(pages);
+    if (!run) {
+        return false;
+    }
+
+    uint32_t count = (pages * PMM_FRAME_SIZE) / chunk_size;
+    for (uint32_t i = 0; i < count; i++) {
+        heap_chunk_t* chunk = (heap_chunk_t*)(run + i * chunk_size);
+        chunk->header.size = chunk_size | HEAP_FLAG_SMALL;
+        chunk->header.info = HEAP_MAGIC | class_index;
+        chunk->next = heap_class_free[class_index];
+        heap_class_free[class_index] = chunk;
+    }
+    heap_class_total[class_index] += count;
+
+    return true;
+}
+
+static void* heap_alloc_small(size_t size) {
+    uint32_t class_index = heap_class_index[(size + HEAP_ALIGN - 1) / HEAP_ALIGN];
+
+    if (!heap_class_free[class_index] && !heap_refill_class(class_index)) {
         return NULL; // Out of memory
     }
-    
-    void* ptr = &heap[heap_offset];
-    heap_offset += size;
-    return ptr;
+
+    heap_chunk_t* chunk = heap_class_free[class_index];
+    heap_class_free[class_index] = chunk->next;
+    chunk->header.size |= HEAP_FLAG_USED;
+
+    return (uint8_t*)chunk + sizeof(heap_header_t);
 }
 
-void kfree(void* ptr) {
-    // Simple allocator - we don't actually free memory
-    // In a real OS, you'd implement proper memory management
-    (void)ptr;
+void memory_init(void) {
+    // Map payload size (in 8-byte units) to the smallest fitting class
+    uint32_t class_index = 0;
+    for (uint32_t units = 0; units < sizeof(heap_class_index); units++) {
+        while (units * HEAP_ALIGN + sizeof(heap_header_t) > heap_class_sizes[class_index]) {
+            class_index++;
+        }
+        heap_class_index[units] = class_index;
+    }
+
+    for (uint32_t i = 0; i < HEAP_CLASS_COUNT; i++) {
+        heap_class_free[i] = NULL;
+    }
+    for (int i = 0; i < HEAP_BIN_COUNT; i++) {
+        heap_bins[i] = NULL;
+    }
+    heap_arena_count = 0;
+
+    memset(&heap_stats, 0, sizeof(heap_stats));
+    memset(heap_sites, 0, sizeof(heap_sites));
+    memset(heap_class_total, 0, sizeof(heap_class_total));
+
+    heap_ready = true;
 }
 
-void* malloc(size_t size) {
-    // Simple malloc implementation - you may want to improve this
-    static char heap_space[1024 * 1024]; // 1MB heap
-    static size_t heap_offset = 0;
-    
-    if (heap_offset + size < sizeof(heap_space)) {
-        void* ptr = &heap_space[heap_offset];
-        heap_offset += size;
-        return ptr;
+// Allocate on behalf of 'caller' and record the call site
+static void* heap_malloc(size_t size, void* caller) {
+    if (!heap_ready) {
+        return NULL;
+    }
+
+    uint32_t start = heap_rdtsc();
+
+    if (size == 0) {
+        size = 1;
     }
-    return NULL; // Out of memory
+
+    void* ptr = NULL;
+    if (size <= HEAP_SMALL_MAX) {
+        ptr = heap_alloc_small(size);
+    } else if (size <= 0x7FFFFFFF) {
+        ptr = heap_alloc_large(size);
+    }
+
+    if (!ptr) {
+        heap_stats.failed_allocs++;
+        return NULL;
+    }
+
+    heap_header_t* header = heap_header_of(ptr);
+    uint32_t site = heap_site_index((uint32_t)caller);
+    heap_set_site(header, site);
+    heap_sites[site].allocs++;
+    heap_stats.alloc_count++;
+    heap_account(header, 0, heap_block_size(header));
+
+    uint32_t cycles = heap_rdtsc() - start;
+    heap_stats.alloc_cycles_avg += ((int32_t)(cycles - heap_stats.alloc_cycles_avg)) / 16;
+    if (cycles > heap_stats.alloc_cycles_max) {
+        heap_stats.alloc_cycles_max = cycles;
+    }
+
+    return ptr;
+}
+
+void* malloc(size_t size) {
+    return heap_malloc(size, __builtin_return_address(0));
 }
 
 void free(void* ptr) {
-    // Simple implementation - doesn't actually free memory
-    // You'd want a proper allocator for production use
-    (void)ptr;
+    if (!ptr) {
+        return;
+    }
+
+    heap_header_t* header = heap_header_of(ptr);
+    if ((header->info & HEAP_MAGIC_MASK) != HEAP_MAGIC || !(header->size & HEAP_FLAG_USED)) {
+        return; // Not ours, or already freed
+    }
+
+    heap_stats.free_count++;
+    heap_sites[heap_site_of(header)].frees++;
+    heap_account(header, heap_block_size(header), 0);
+
+    if (header->size & HEAP_FLAG_SMALL) {
+        heap_chunk_t* chunk = (heap_chunk_t*)header;
+        uint32_t class_index = header->info & HEAP_CLASS_MASK;
+        chunk->header.size &= ~HEAP_FLAG_USED;
+        chunk->next = heap_class_free[class_index];
+        heap_class_free[class_index] = chunk;
+        return;
+    }
+
+    heap_free_large(header);
+}
+
+// Usable payload size of an allocated block
+static size_t heap_usable_size(heap_header_t* header) {
+    if (header->size & HEAP_FLAG_SMALL) {
+        return heap_block_size(header) - sizeof(heap_header_t);
+    }
+    return heap_block_size(header) - HEAP_LARGE_OVERHEAD;
 }
 
 void* realloc(void* ptr, size_t size) {
-    // Simple implementation
     if (ptr == NULL) {
-        return malloc(size);
+        return heap_malloc(size, __builtin_return_address(0));
     }
-    // For now, just return the same pointer
-    // A real implementation would copy data to new location
-    return ptr;
+
+    if (size == 0) {
+        free(ptr);
+        return NULL;
+    }
+
+    heap_header_t* header = heap_header_of(ptr);
+    if ((header->info & HEAP_MAGIC_MASK) != HEAP_MAGIC || !(header->size & HEAP_FLAG_USED)) {
+        return NULL;
+    }
+
+    size_t current = heap_usable_size(header);
+
+    if (!(header->size & HEAP_FLAG_SMALL) && size > HEAP_SMALL_MAX && size <= 0x7FFFFFFF) {
+        uint32_t needed = (size + HEAP_LARGE_OVERHEAD + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+
+        uint32_t old_size = heap_block_size(header);
+
+        // Shrink in place
+        if (needed <= old_size) {
+            heap_split(header, needed);
+            heap_account(header, old_size, heap_block_size(header));
+            return ptr;
+        }
+
+        // Grow in place by absorbing a free neighbour
+        heap_header_t* next = heap_next_block(header);
+        if (!(next->size & HEAP_FLAG_USED) &&
+            old_size + heap_block_size(next) >= needed) {
+            uint32_t site = heap_site_of(header);
+            heap_bin_remove((heap_free_block_t*)next);
+            heap_set_large(header, old_size + heap_block_size(next), HEAP_FLAG_USED);
+            heap_set_site(header, site);
+            heap_split(header, needed);
+            heap_account(header, old_size, heap_block_size(header));
+            return ptr;
+        }
+    } else if (size <= current) {
+        return ptr; // Still fits in its size class
+    }
+
+    void* new_ptr = heap_malloc(size, __builtin_return_address(0));
+    if (!new_ptr) {
+        return NULL; // Original block is left untouched
+    }
+
+    memcpy(new_ptr, ptr, current < size ? current : size);
+    free(ptr);
+    return new_ptr;
 }
 
 void* calloc(size_t num, size_t size) {
+    if (size != 0 && num > (size_t)-1 / size) {
+        return NULL; // Overflow
+    }
+
     size_t total = num * size;
-    void* ptr = malloc(total);
+    void* ptr = heap_malloc(total, __builtin_return_address(0));
     if (ptr) {
-        // Zero the memory
-        char* p = (char*)ptr;
-        for (size_t i = 0; i < total; i++) {
-            p[i] = 0;
-        }
+        memset(ptr, 0, total);
     }
     return ptr;
 }
 
-void memory_init(void) {
-    heap_offset = 0;
-}
\ No newline at end of file
+// The kernel and libc-style allocators share one heap
+void* kmalloc(size_t size) {
+    return heap_malloc(size, __builtin_return_address(0));
+}
+
+void kfree(void* ptr) {
+    free(ptr);
+}
+
+void heap_get_stats(heap_stats_t* stats) {
+    if (!stats) {
+        return;
+    }
+
+    memcpy(stats, &heap_stats, sizeof(heap_stats_t));
+    stats->arena_count = heap_arena_count;
+    stats->small_free_bytes = 0;
+    stats->large_free_bytes = 0;
+    stats->largest_free_block = 0;
+
+    for (uint32_t i = 0; i < HEAP_CLASS_COUNT; i++) {
+        uint32_t free_chunks = 0;
+        for (heap_chunk_t* chunk = heap_class_free[i]; chunk; chunk = chunk->next) {
+            free_chunks++;
+        }
+        stats->class_size[i] = heap_class_sizes[i];
+        stats->class_free[i] = free_chunks;
+        stats->class_in_use[i] = heap_class_total[i] - free_chunks;
+        stats->small_free_bytes += free_chunks * heap_class_sizes[i];
+    }
+
+    for (int i = 0; i < HEAP_BIN_COUNT; i++) {
+        for (heap_free_block_t* block = heap_bins[i]; block; block = block->next) {
+            uint32_t size = heap_block_size(&block->header);
+            stats->large_free_bytes += size;
+            if (size > stats->largest_free_block) {
+                stats->largest_free_block = size;
+            }
+        }
+    }
+
+    // External fragmentation of the arenas: how much free space is not
+    // usable as one block
+    stats->fragmentation = 0;
+    if (stats->large_free_bytes > 0) {
+        uint32_t largest = stats->largest_free_block;
+        uint32_t total = stats->large_free_bytes;
+        while (total > 0x00FFFFFF) {
+            largest >>= 1; // Keep largest * 100 within 32 bits
+            total >>= 1;
+        }
+        stats->fragmentation = 100 - (largest * 100) / total;
+    }
+}
+
+uint32_t heap_get_sites(heap_site_stats_t* sites, uint32_t max_sites) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < HEAP_MAX_SITES && count < max_sites; i++) {
+        if (heap_sites[i].allocs == 0) {
+            continue;
+        }
+        sites[count++] = heap_sites[i];
+    }
+    return count;
+}
@@ -4,6 +4,7 @@
 #include "../include/dhcp.h"
 #include "../include/network.h"
 #include "../include/memory.h"
+#include "../include/slab.h"
 #include "../include/string.h"
 #include "../include/io.h"
 #include "../include/rtl8139.h"
@@ -23,16 +24,44 @@ static uint32_t gateway_ip = 0;
 static uint32_t netmask = 0;
 static uint8_t local_mac[6] = {0};
 
-// ARP table entry
-typedef struct {
+// ARP table entry, chained per hash bucket
+typedef struct arp_entry {
     uint32_t ip;
     uint8_t mac[6];
     bool valid;
     uint32_t timestamp;
+    struct arp_entry* next;
 } arp_entry_t;
 
-#define ARP_TABLE_SIZE 16
-static arp_entry_t arp_table[ARP_TABLE_SIZE];
+#define ARP_HASH_BUCKETS 64
+static arp_entry_t* arp_table[ARP_HASH_BUCKETS];
+static slab_cache_t* arp_cache = NULL;
+
+// Ethernet frame buffers
+static slab_cache_t* frame_cache = NULL;
+
+static inline uint32_t arp_hash(uint32_t ip) {
+    // Low octets vary most on a local subnet
+    return (ip ^ (ip >> 8)) & (ARP_HASH_BUCKETS - 1);
+}
+
+static arp_entry_t* arp_lookup(uint32_t ip) {
+    for (arp_entry_t* entry = arp_table[arp_hash(ip)]; entry; entry = entry->next) {
+        if (entry->valid && entry->ip == ip) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Frame buffers are NETWORK_FRAME_SIZE bytes, cache line aligned
+uint8_t* network_alloc_frame(void) {
+    return (uint8_t*)slab_alloc(frame_cache);
+}
+
+void network_free_frame(uint8_t* frame) {
+    slab_free(frame_cache, frame);
+}
 
 // Network byte order conversion functions
 uint16_t htons(uint16_t hostshort) {
@@ -138,8 +167,14 @@ void ip_int_to_str(uint32_t ip, char* str) {
 // Initialize network stack
 void network_init(void) {
     // Initialize ARP table
-    for (int i = 0; i < ARP_TABLE_SIZE; i++) {
-        arp_table[i].valid = false;
+    for (int i = 0; i < ARP_HASH_BUCKETS; i++) {
+        arp_table[i] = NULL;
+    }
+    if (!arp_cache) {
+        arp_cache = slab_cache_create("arp_entry", sizeof(arp_entry_t), 0, NULL);
+    }
+    if (!frame_cache) {
+        frame_cache = slab_cache_create("net_frame", NETWORK_FRAME_SIZE, 0, NULL);
     }
     
     // Initialize RTL8139 driver
@@ -218,11 +253,10 @@ bool network_ping(uint32_t target_ip) {
 // ARP functions
 bool arp_resolve(uint32_t ip, uint8_t* mac) {
     // Check ARP table first
-    for (int i = 0; i < ARP_TABLE_SIZE; i++) {
-        if (arp_table[i].valid && arp_table[i].ip == ip) {
-            memcpy(mac, arp_table[i].mac, 6);
-            return true;
-        }
+    arp_entry_t* entry = arp_lookup(ip);
+    if (entry) {
+        memcpy(mac, entry->mac, 6);
+        return true;
     }
     
     // Not found, send ARP request
@@ -269,14 +303,21 @@ void arp_process_packet(const arp_packet_t* arp) {
     uint32_t target_ip = ntohl(arp->target_ip);
     
     // Update ARP table with sender info
-    for (int i = 0; i < ARP_TABLE_SIZE; i++) {
-        if (!arp_table[i].valid) {
-            arp_table[i].ip = sender_ip;
-            memcpy(arp_table[i].mac, arp->sender_mac, 6);
-            arp_table[i].valid = true;
-            break;
+    arp_entry_t* entry = arp_lookup(sender_ip);
+    if (!entry) {
+        entry = (arp_entry_t*)slab_alloc(arp_cache);
+        if (entry) {
+            uint32_t bucket = arp_hash(sender_ip);
+            entry->ip = sender_ip;
+            entry->timestamp = 0;
+            entry->next = arp_table[bucket];
+            arp_table[bucket] = entry;
         }
     }
+    if (entry) {
+        memcpy(entry->mac, arp->sender_mac, 6);
+        entry->valid = true;
+    }
     
     // If this is a request for our IP, send a reply
     if (ntohs(arp->operation) == ARP_OPERATION_REQUEST && target_ip == local_ip) {
@@ -311,10 +352,8 @@ bool network_send_ethernet_frame(const uint8_t* dest_mac, uint16_t ethertype, co
         return false;
     }
     
-    // Use static buffer instead of kmalloc
-    static uint8_t packet[1514]; // Max ethernet frame size
-    
-    if (14 + payload_len > sizeof(packet)) {
+    uint8_t* packet = network_alloc_frame();
+    if (!packet) {
         return false;
     }
     
@@ -333,6 +372,7 @@ bool network_send_ethernet_frame(const uint8_t* dest_mac, uint16_t ethertype, co
     }
     
     bool result = rtl8139_send_packet(packet, 14 + payload_len);
+    network_free_frame(packet);
     return result;
 }
 
@@ -676,8 +716,12 @@ void network_process_packets(void) {
         return;
     }
     
-    uint8_t buffer[1600]; // Max ethernet frame size
-    int packet_len = rtl8139_receive_packet(buffer, sizeof(buffer));
+    uint8_t* buffer = network_alloc_frame();
+    if (!buffer) {
+        return;
+    }
+    
+    int packet_len = rtl8139_receive_packet(buffer, NETWORK_FRAME_SIZE);
     
     if (packet_len > 0) {
         network_update_stats(false, packet_len, false);
@@ -707,6 +751,8 @@ void network_process_packets(void) {
             }
         }
     }
+    
+    network_free_frame(buffer);
 }
 
 static void process_ip_packet(const ip_header_t* ip_hdr, uint16_t packet_len) {
@@ -0,0 +1,352 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/pmm.h"
+#include "../include/string.h"
+
+extern void terminal_writestring(const char* data);
+
+// Kernel image bounds from linker.ld
+extern uint8_t _kernel_start[];
+extern uint8_t _kernel_end[];
+
+// Used when the bootloader gives us no memory information at all
+#define PMM_FALLBACK_MEMORY (8 * 1024 * 1024)
+
+#define PMM_MAX_REGIONS 32
+
+typedef struct {
+    uint32_t base;
+    uint32_t end;   // exclusive
+} pmm_region_t;
+
+// One bit per frame, set = used. Frames outside any usable region stay set.
+static uint32_t* frame_bitmap = NULL;
+static uint32_t bitmap_words = 0;
+static uint32_t bitmap_bytes = 0;   // Frame-rounded size of the bitmap
+static uint32_t total_frames = 0;
+static uint32_t usable_frames = 0;
+static uint32_t free_frames = 0;
+static uint32_t highest_address = 0;
+static bool pmm_ready = false;
+
+// Every bitmap word below this index is known to be full
+static uint32_t next_free_word = 0;
+
+static inline uint32_t align_up(uint32_t value, uint32_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+static inline uint32_t align_down(uint32_t value, uint32_t align) {
+    return value & ~(align - 1);
+}
+
+static inline bool frame_test(uint32_t frame) {
+    return (frame_bitmap[frame >> 5] & (1u << (frame & 31))) != 0;
+}
+
+static inline void frame_set(uint32_t frame) {
+    uint32_t bit = 1u << (frame & 31);
+    if (!(frame_bitmap[frame >> 5] & bit)) {
+        frame_bitmap[frame >> 5] |= bit;
+        free_frames--;
+    }
+}
+
+static inline void frame_clear(uint32_t frame) {
+    uint32_t bit = 1u << (frame & 31);
+    if (frame_bitmap[frame >> 5] & bit) {
+        frame_bitmap[frame >> 5] &= ~bit;
+        free_frames++;
+        if ((frame >> 5) < next_free_word) {
+            next_free_word = frame >> 5;
+        }
+    }
+}
+
+// Build the list of usable regions from the multiboot memory map,
+// falling back to mem_upper when no map was provided
+static int pmm_collect_regions(const multiboot_info_t* mbi, pmm_region_t* regions) {
+    int count = 0;
+
+    if (mbi && (mbi->flags & MULTIBOOT_FLAG_MMAP)) {
+        uint32_t addr = mbi->mmap_addr;
+        uint32_t end = mbi->mmap_addr + mbi->mmap_length;
+
+        while (addr < end && count < PMM_MAX_REGIONS) {
+            const multiboot_memory_map_t* mmap = (const multiboot_memory_map_t*)addr;
+
+            if (mmap->type == MULTIBOOT_MEMORY_AVAILABLE && mmap->addr < 0x100000000ULL) {
+                uint64_t region_end = mmap->addr + mmap->len;
+                if (region_end > 0xFFFFF000ULL) {
+                    region_end = 0xFFFFF000ULL;
+                }
+                if (region_end > mmap->addr) {
+                    regions[count].base = (uint32_t)mmap->addr;
+                    regions[count].end = (uint32_t)region_end;
+                    count++;
+                }
+            }
+
+            addr += mmap->size + sizeof(mmap->size);
+        }
+    } else if (mbi && (mbi->flags & MULTIBOOT_FLAG_MEM)) {
+        regions[0].base = PMM_LOW_MEMORY_LIMIT;
+        regions[0].end = PMM_LOW_MEMORY_LIMIT + mbi->mem_upper * 1024;
+        count = 1;
+    } else {
+        regions[0].base = align_up((uint32_t)_kernel_end, PMM_FRAME_SIZE);
+        regions[0].end = regions[0].base + PMM_FALLBACK_MEMORY;
+        count = 1;
+        terminal_writestring("PMM: No memory map from bootloader, assuming 8MB after kernel\n");
+    }
+
+    return count;
+}
+
+// Ranges the bootloader left for us that must survive allocation
+static int pmm_collect_boot_data(const multiboot_info_t* mbi, pmm_region_t* ranges) {
+    int count = 0;
+
+    if (!mbi) {
+        return 0;
+    }
+
+    ranges[count].base = (uint32_t)mbi;
+    ranges[count].end = (uint32_t)mbi + sizeof(multiboot_info_t);
+    count++;
+
+    if (mbi->flags & MULTIBOOT_FLAG_MMAP) {
+        ranges[count].base = mbi->mmap_addr;
+        ranges[count].end = mbi->mmap_addr + mbi->mmap_length;
+        count++;
+    }
+
+    if ((mbi->flags & MULTIBOOT_FLAG_CMDLINE) && mbi->cmdline) {
+        ranges[count].base = mbi->cmdline;
+        ranges[count].end = mbi->cmdline + strlen((const char*)mbi->cmdline) + 1;
+        count++;
+    }
+
+    if ((mbi->flags & MULTIBOOT_FLAG_LOADER) && mbi->boot_loader_name) {
+        ranges[count].base = mbi->boot_loader_name;
+        ranges[count].end = mbi->boot_loader_name + strlen((const char*)mbi->boot_loader_name) + 1;
+        count++;
+    }
+
+    return count;
+}
+
+// Find a frame-aligned spot for the bitmap above the kernel that does not
+// overlap the bootloader's data
+static uint32_t pmm_place_bitmap(const pmm_region_t* regions, int region_count,
+                                 const pmm_region_t* boot, int boot_count, uint32_t size) {
+    uint32_t kernel_end = align_up((uint32_t)_kernel_end, PMM_FRAME_SIZE);
+
+    for (int i = 0; i < region_count; i++) {
+        uint32_t candidate = regions[i].base;
+        if (candidate < kernel_end) {
+            candidate = kernel_end;
+        }
+        candidate = align_up(candidate, PMM_FRAME_SIZE);
+
+        bool moved = true;
+        while (moved) {
+            moved = false;
+            for (int j = 0; j < boot_count; j++) {
+                if (candidate < boot[j].end && candidate + size > boot[j].base) {
+                    candidate = align_up(boot[j].end, PMM_FRAME_SIZE);
+                    moved = true;
+                }
+            }
+        }
+
+        if (candidate >= regions[i].base && candidate + size <= regions[i].end &&
+            candidate + size > candidate) {
+            return candidate;
+        }
+    }
+
+    return 0;
+}
+
+static void pmm_print_mb(const char* label, uint32_t frames) {
+    char buffer[16];
+    terminal_writestring(label);
+    itoa(frames / (1024 * 1024 / PMM_FRAME_SIZE), buffer, 10);
+    terminal_writestring(buffer);
+    terminal_writestring(" MB");
+}
+
+void pmm_init(const multiboot_info_t* mbi) {
+    pmm_region_t regions[PMM_MAX_REGIONS];
+    pmm_region_t boot[4];
+
+    int region_count = pmm_collect_regions(mbi, regions);
+    int boot_count = pmm_collect_boot_data(mbi, boot);
+
+    // Size the bitmap to cover the highest usable address
+    highest_address = 0;
+    for (int i = 0; i < region_count; i++) {
+        if (regions[i].end > highest_address) {
+            highest_address = regions[i].end;
+        }
+    }
+
+    total_frames = highest_address >> PMM_FRAME_SHIFT;
+    bitmap_words = (total_frames + 31) / 32;
+    uint32_t bitmap_size = align_up(bitmap_words * sizeof(uint32_t), PMM_FRAME_SIZE);
+
+    uint32_t bitmap_addr = pmm_place_bitmap(regions, region_count, boot, boot_count, bitmap_size);
+    if (bitmap_addr == 0) {
+        terminal_writestring("PMM: No room for frame bitmap, physical allocator disabled\n");
+        return;
+    }
+    frame_bitmap = (uint32_t*)bitmap_addr;
+    bitmap_bytes = bitmap_size;
+
+    // Start with everything used, then release the usable regions
+    memset(frame_bitmap, 0xFF, bitmap_words * sizeof(uint32_t));
+    free_frames = 0;
+    next_free_word = bitmap_words;
+
+    for (int i = 0; i < region_count; i++) {
+        uint32_t first = align_up(regions[i].base, PMM_FRAME_SIZE) >> PMM_FRAME_SHIFT;
+        uint32_t last = align_down(regions[i].end, PMM_FRAME_SIZE) >> PMM_FRAME_SHIFT;
+        for (uint32_t frame = first; frame < last; frame++) {
+            frame_clear(frame);
+        }
+    }
+    usable_frames = free_frames;
+
+    // Low memory, the kernel image, the bitmap itself and boot data stay put
+    pmm_reserve_region(0, PMM_LOW_MEMORY_LIMIT);
+    pmm_reserve_region((uint32_t)_kernel_start, (uint32_t)_kernel_end - (uint32_t)_kernel_start);
+    pmm_reserve_region(bitmap_addr, bitmap_size);
+    for (int i = 0; i < boot_count; i++) {
+        pmm_reserve_region(boot[i].base, boot[i].end - boot[i].base);
+    }
+
+    pmm_ready = true;
+
+    pmm_print_mb("PMM: ", usable_frames);
+    pmm_print_mb(" usable, ", free_frames);
+    terminal_writestring(" free for allocation\n");
+}
+
+void pmm_reserve_region(uint32_t base, uint32_t length) {
+    if (!frame_bitmap || length == 0) {
+        return;
+    }
+
+    uint32_t first = align_down(base, PMM_FRAME_SIZE) >> PMM_FRAME_SHIFT;
+    uint32_t last = align_up(base + length, PMM_FRAME_SIZE) >> PMM_FRAME_SHIFT;
+    if (last > total_frames || last < first) {
+        last = total_frames;
+    }
+
+    for (uint32_t frame = first; frame < last; frame++) {
+        frame_set(frame);
+    }
+}
+
+uint32_t pmm_alloc_frame(void) {
+    if (!pmm_ready) {
+        return 0;
+    }
+
+    for (uint32_t word = next_free_word; word < bitmap_words; word++) {
+        if (frame_bitmap[word] == 0xFFFFFFFF) {
+            continue;
+        }
+
+        uint32_t frame = word * 32 + __builtin_ctz(~frame_bitmap[word]);
+        if (frame >= total_frames) {
+            break;
+        }
+
+        next_free_word = word;
+        frame_set(frame);
+        return frame << PMM_FRAME_SHIFT;
+    }
+
+    next_free_word = bitmap_words;
+    return 0; // Out of memory
+}
+
+// Allocate physically contiguous frames. align_frames must be a power of
+// two; limit is an exclusive physical upper bound (0 = no limit).
+uint32_t pmm_alloc_frames(uint32_t count, uint32_t align_frames, uint32_t limit) {
+    if (!pmm_ready || count == 0) {
+        return 0;
+    }
+
+    if (count == 1 && align_frames <= 1 && limit == 0) {
+        return pmm_alloc_frame();
+    }
+
+    if (align_frames == 0) {
+        align_frames = 1;
+    }
+
+    uint32_t max_frame = total_frames;
+    if (limit != 0 && (limit >> PMM_FRAME_SHIFT) < max_frame) {
+        max_frame = limit >> PMM_FRAME_SHIFT;
+    }
+
+    uint32_t frame = align_up(next_free_word * 32, align_frames);
+    while (frame + count <= max_frame && frame + count > frame) {
+        uint32_t i;
+        for (i = 0; i < count; i++) {
+            if (frame_test(frame + i)) {
+                break;
+            }
+        }
+
+        if (i == count) {
+            for (i = 0; i < count; i++) {
+                frame_set(frame + i);
+            }
+            return frame << PMM_FRAME_SHIFT;
+        }
+
+        frame = align_up(frame + i + 1, align_frames);
+    }
+
+    return 0; // No suitable run
+}
+
+void pmm_free_frame(uint32_t addr) {
+    uint32_t frame = addr >> PMM_FRAME_SHIFT;
+    if (!pmm_ready || frame >= total_frames || addr < PMM_LOW_MEMORY_LIMIT) {
+        return;
+    }
+    frame_clear(frame);
+}
+
+void pmm_free_frames(uint32_t addr, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        pmm_free_frame(addr + i * PMM_FRAME_SIZE);
+    }
+}
+
+bool pmm_is_initialized(void) {
+    return pmm_ready;
+}
+
+uint32_t pmm_get_total_frames(void) {
+    return usable_frames;
+}
+
+uint32_t pmm_get_free_frames(void) {
+    return free_frames;
+}
+
+uint32_t pmm_get_highest_address(void) {
+    return highest_address;
+}
+
+void pmm_get_bitmap_region(uint32_t* base, uint32_t* size) {
+    *base = (uint32_t)frame_bitmap;
+    *size = bitmap_bytes;
+}
@@ -0,0 +1,206 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/ramdisk.h"
+#include "../include/memory.h"
+#include "../include/pmm.h"
+#include "../include/vmm.h"
+#include "../include/string.h"
+
+// RAM disk block backend
+//
+// The disk is a table of page pointers, one per 4KB of disk. A NULL entry
+// is a page that has never been written and reads as zeros, so a fresh disk
+// costs only its page table no matter how large it is.
+
+static uint8_t** ramdisk_pages = NULL;
+static uint32_t ramdisk_page_count = 0;
+static uint32_t ramdisk_sectors = 0;
+static uint32_t ramdisk_resident = 0;
+static const uint8_t ramdisk_zero_page[RAMDISK_PAGE_SIZE] __attribute__((aligned(RAMDISK_PAGE_SIZE)));
+
+bool ramdisk_create(uint32_t sectors) {
+    if (ramdisk_pages) {
+        return false; // Already exists
+    }
+
+    uint32_t pages = (sectors + RAMDISK_SECTORS_PER_PAGE - 1) / RAMDISK_SECTORS_PER_PAGE;
+    if (pages == 0) {
+        return false;
+    }
+
+    ramdisk_pages = (uint8_t**)calloc(pages, sizeof(uint8_t*));
+    if (!ramdisk_pages) {
+        return false;
+    }
+
+    ramdisk_page_count = pages;
+    ramdisk_sectors = sectors;
+    ramdisk_resident = 0;
+    return true;
+}
+
+void ramdisk_destroy(void) {
+    if (!ramdisk_pages) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < ramdisk_page_count; i++) {
+        if (ramdisk_pages[i]) {
+            vmm_unmap((uint32_t)ramdisk_pages[i], 1);
+            pmm_free_frame((uint32_t)ramdisk_pages[i]);
+        }
+    }
+
+    free(ramdisk_pages);
+    ramdisk_pages = NULL;
+    ramdisk_page_count = 0;
+    ramdisk_sectors = 0;
+    ramdisk_resident = 0;
+}
+
+bool ramdisk_is_ready(void) {
+    return ramdisk_pages != NULL;
+}
+
+// Back a page with memory. Skips zeroing when the caller is about to
+// overwrite the whole page anyway.
+static uint8_t* ramdisk_materialize(uint32_t index, bool zero) {
+    uint32_t frame = pmm_alloc_frame();
+    if (!frame) {
+        return NULL;
+    }
+    if (!vmm_map(frame, frame, 1, VMM_PAGE_WRITE)) {
+        pmm_free_frame(frame);
+        return NULL;
+    }
+
+    uint8_t* page = (uint8_t*)frame;
+    if (zero) {
+        memset(page, 0, RAMDISK_PAGE_SIZE);
+    }
+
+    ramdisk_pages[index] = page;
+    ramdisk_resident++;
+    return page;
+}
+
+bool ramdisk_read_sectors(uint32_t sector, uint32_t count, void* buffer) {
+    if (!ramdisk_pages || sector >= ramdisk_sectors || count > ramdisk_sectors - sector) {
+        return false;
+    }
+
+    uint8_t* dst = (uint8_t*)buffer;
+    while (count > 0) {
+        uint32_t index = sector / RAMDISK_SECTORS_PER_PAGE;
+        uint32_t first = sector % RAMDISK_SECTORS_PER_PAGE;
+        uint32_t run = RAMDISK_SECTORS_PER_PAGE - first;
+        if (run > count) {
+            run = count;
+        }
+
+        uint32_t bytes = run * RAMDISK_SECTOR_SIZE;
+        if (ramdisk_pages[index]) {
+            memcpy(dst, ramdisk_pages[index] + first * RAMDISK_SECTOR_SIZE, bytes);
+        } else {
+            memset(dst, 0, bytes);
+        }
+
+        dst += bytes;
+        sector += run;
+        count -= run;
+    }
+
+    return true;
+}
+
+bool ramdisk_write_sectors(uint32_t sector, uint32_t count, const void* buffer) {
+    if (!ramdisk_pages || sector >= ramdisk_sectors || count > ramdisk_sectors - sector) {
+        return false;
+    }
+
+    const uint8_t* src = (const uint8_t*)buffer;
+    while (count > 0) {
+        uint32_t index = sector / RAMDISK_SECTORS_PER_PAGE;
+        uint32_t first = sector % RAMDISK_SECTORS_PER_PAGE;
+        uint32_t run = RAMDISK_SECTORS_PER_PAGE - first;
+        if (run > count) {
+            run = count;
+        }
+
+        uint8_t* page = ramdisk_pages[index];
+        if (!page) {
+            page = ramdisk_materialize(index, run != RAMDISK_SECTORS_PER_PAGE);
+            if (!page) {
+                return false; // Out of memory
+            }
+        }
+
+        uint32_t bytes = run * RAMDISK_SECTOR_SIZE;
+        memcpy(page + first * RAMDISK_SECTOR_SIZE, src, bytes);
+
+        src += bytes;
+        sector += run;
+        count -= run;
+    }
+
+    return true;
+}
+
+const void* ramdisk_map_sectors(uint32_t sector, uint32_t* count) {
+    if (!ramdisk_pages || sector >= ramdisk_sectors || *count == 0) {
+        *count = 0;
+        return NULL;
+    }
+    if (*count > ramdisk_sectors - sector) {
+        *count = ramdisk_sectors - sector;
+    }
+
+    uint32_t index = sector / RAMDISK_SECTORS_PER_PAGE;
+    uint32_t first = sector % RAMDISK_SECTORS_PER_PAGE;
+    uint32_t available = RAMDISK_SECTORS_PER_PAGE - first;
+    const uint8_t* page = ramdisk_pages[index];
+
+    if (!page) {
+        if (*count > available) {
+            *count = available;
+        }
+        return ramdisk_zero_page + first * RAMDISK_SECTOR_SIZE;
+    }
+
+    // Carry on through pages whose frames happen to follow each other
+    while (available < *count && ramdisk_pages[index + 1] == page + RAMDISK_PAGE_SIZE) {
+        page += RAMDISK_PAGE_SIZE;
+        index++;
+        available += RAMDISK_SECTORS_PER_PAGE;
+    }
+    if (*count > available) {
+        *count = available;
+    }
+    return ramdisk_pages[sector / RAMDISK_SECTORS_PER_PAGE] + first * RAMDISK_SECTOR_SIZE;
+}
+
+uint32_t ramdisk_pick_size(void) {
+    // Half of free memory; pages only become resident as they are written
+    uint32_t bytes = RAMDISK_MIN_SIZE;
+    if (pmm_is_initialized()) {
+        uint32_t free_frames = pmm_get_free_frames() / 2;
+        if (free_frames < RAMDISK_MAX_SIZE / PMM_FRAME_SIZE) {
+            bytes = free_frames * PMM_FRAME_SIZE;
+        } else {
+            bytes = RAMDISK_MAX_SIZE;
+        }
+        if (bytes < RAMDISK_MIN_SIZE) {
+            bytes = RAMDISK_MIN_SIZE;
+        }
+    }
+    return bytes / RAMDISK_SECTOR_SIZE;
+}
+
+uint32_t ramdisk_get_sector_count(void) {
+    return ramdisk_sectors;
+}
+
+uint32_t ramdisk_get_resident_pages(void) {
+    return ramdisk_resident;
+}
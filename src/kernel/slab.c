@@ -0,0 +1,230 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/slab.h"
+#include "../include/memory.h"
+#include "../include/pmm.h"
+#include "../include/vmm.h"
+#include "../include/string.h"
+
+// Slab allocator
+//
+// Each slab is a naturally aligned run of 2^n frames holding a header, a
+// free-index array and the objects themselves. Because slabs are aligned to
+// their own size, slab_free() finds the owning slab by masking the pointer.
+// The free list lives outside the objects so constructed state survives a
+// free/alloc round trip.
+
+#define SLAB_END         0xFFFF
+#define SLAB_MAX_PAGES   16
+#define SLAB_MIN_OBJECTS 8
+
+struct slab {
+    slab_cache_t* cache;
+    struct slab* next;
+    struct slab* prev;
+    uint16_t free_head;     // First free object index, SLAB_END if full
+    uint16_t in_use;
+    uint16_t free_next[];   // Next free index for every object
+};
+
+static slab_cache_t* slab_caches = NULL;
+
+static inline uint32_t slab_align_up(uint32_t value, uint32_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+static void slab_list_push(slab_t** head, slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *head;
+    if (*head) {
+        (*head)->prev = slab;
+    }
+    *head = slab;
+}
+
+static void slab_list_remove(slab_t** head, slab_t* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *head = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+}
+
+static inline uint8_t* slab_object(slab_cache_t* cache, slab_t* slab, uint32_t index) {
+    return (uint8_t*)slab + cache->first_object_offset + index * cache->stride;
+}
+
+static slab_t* slab_grow(slab_cache_t* cache) {
+    uint32_t phys = pmm_alloc_frames(cache->slab_pages, cache->slab_pages, 0);
+    if (!phys) {
+        return NULL; // Out of memory
+    }
+    if (!vmm_map(phys, phys, cache->slab_pages, VMM_PAGE_WRITE)) {
+        pmm_free_frames(phys, cache->slab_pages);
+        return NULL;
+    }
+
+    slab_t* slab = (slab_t*)phys;
+    slab->cache = cache;
+    slab->in_use = 0;
+    slab->free_head = 0;
+
+    for (uint32_t i = 0; i < cache->objects_per_slab; i++) {
+        slab->free_next[i] = (i + 1 < cache->objects_per_slab) ? i + 1 : SLAB_END;
+        if (cache->ctor) {
+            cache->ctor(slab_object(cache, slab, i));
+        }
+    }
+
+    cache->slab_count++;
+    return slab;
+}
+
+slab_cache_t* slab_cache_create(const char* name, size_t size, size_t align, slab_ctor_t ctor) {
+    if (size == 0) {
+        return NULL;
+    }
+
+    if (align == 0) {
+        align = SLAB_CACHE_LINE_SIZE;
+    }
+    if (align & (align - 1)) {
+        return NULL; // Alignment must be a power of two
+    }
+
+    uint32_t stride = slab_align_up(size, align);
+
+    // Pick the smallest slab that holds a reasonable number of objects
+    uint32_t pages;
+    uint32_t count = 0;
+    uint32_t offset = 0;
+    for (pages = 1; pages <= SLAB_MAX_PAGES; pages *= 2) {
+        uint32_t bytes = pages * PMM_FRAME_SIZE;
+        count = (bytes - sizeof(slab_t)) / (stride + sizeof(uint16_t));
+        if (count >= SLAB_END) {
+            count = SLAB_END - 1;
+        }
+        while (count > 0) {
+            offset = slab_align_up(sizeof(slab_t) + count * sizeof(uint16_t), align);
+            if (offset + count * stride <= bytes) {
+                break;
+            }
+            count--;
+        }
+        if (count >= SLAB_MIN_OBJECTS || (pages == SLAB_MAX_PAGES && count > 0)) {
+            break;
+        }
+    }
+
+    if (count == 0 || pages > SLAB_MAX_PAGES) {
+        return NULL; // Object too large for a slab
+    }
+
+    slab_cache_t* cache = (slab_cache_t*)kmalloc(sizeof(slab_cache_t));
+    if (!cache) {
+        return NULL;
+    }
+
+    memset(cache, 0, sizeof(slab_cache_t));
+    strncpy(cache->name, name ? name : "anon", SLAB_NAME_LENGTH - 1);
+    cache->object_size = size;
+    cache->stride = stride;
+    cache->objects_per_slab = count;
+    cache->slab_pages = pages;
+    cache->first_object_offset = offset;
+    cache->ctor = ctor;
+
+    cache->next = slab_caches;
+    slab_caches = cache;
+
+    return cache;
+}
+
+void* slab_alloc(slab_cache_t* cache) {
+    if (!cache) {
+        return NULL;
+    }
+
+    slab_t* slab = cache->partial;
+    if (!slab) {
+        slab = cache->empty;
+        if (slab) {
+            slab_list_remove(&cache->empty, slab);
+        } else {
+            slab = slab_grow(cache);
+            if (!slab) {
+                cache->failed_allocs++;
+                return NULL;
+            }
+        }
+        slab_list_push(&cache->partial, slab);
+    }
+
+    uint32_t index = slab->free_head;
+    slab->free_head = slab->free_next[index];
+    slab->in_use++;
+    cache->objects_in_use++;
+    cache->alloc_count++;
+    if (cache->objects_in_use > cache->peak_in_use) {
+        cache->peak_in_use = cache->objects_in_use;
+    }
+
+    if (slab->free_head == SLAB_END) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_push(&cache->full, slab);
+    }
+
+    return slab_object(cache, slab, index);
+}
+
+void slab_free(slab_cache_t* cache, void* obj) {
+    if (!cache || !obj) {
+        return;
+    }
+
+    uint32_t slab_bytes = cache->slab_pages * PMM_FRAME_SIZE;
+    slab_t* slab = (slab_t*)((uint32_t)obj & ~(slab_bytes - 1));
+    if (slab->cache != cache) {
+        return; // Object does not belong to this cache
+    }
+
+    uint32_t offset = (uint32_t)obj - (uint32_t)slab - cache->first_object_offset;
+    if (offset % cache->stride != 0) {
+        return;
+    }
+    uint32_t index = offset / cache->stride;
+
+    bool was_full = slab->free_head == SLAB_END;
+    slab->free_next[index] = slab->free_head;
+    slab->free_head = index;
+    slab->in_use--;
+    cache->objects_in_use--;
+    cache->free_count++;
+
+    if (was_full) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_push(&cache->partial, slab);
+    }
+
+    if (slab->in_use == 0) {
+        slab_list_remove(&cache->partial, slab);
+
+        // Keep one empty slab around to absorb alloc/free ping-pong
+        if (!cache->empty) {
+            slab_list_push(&cache->empty, slab);
+        } else {
+            slab->cache = NULL;
+            vmm_unmap((uint32_t)slab, cache->slab_pages);
+            pmm_free_frames((uint32_t)slab, cache->slab_pages);
+            cache->slab_count--;
+        }
+    }
+}
+
+slab_cache_t* slab_cache_first(void) {
+    return slab_caches;
+}
@@ -1,10 +1,44 @@
+#include <stdbool.h>
+#include <stdint.h>
 #include "../include/string.h"
+#include "../include/cpu.h"
+
+// Word-at-a-time scanning
+//
+// The scanners read aligned dwords and test four bytes at once with the
+// has-zero-byte trick. An aligned dword never straddles a page, so looking
+// a few bytes past the terminator cannot fault.
+
+#define SWAR_ONES  0x01010101u
+#define SWAR_HIGHS 0x80808080u
+
+typedef uint32_t __attribute__((may_alias)) string_word_t;
+
+static inline bool swar_has_zero(uint32_t x) {
+    return ((x - SWAR_ONES) & ~x & SWAR_HIGHS) != 0;
+}
+
+static inline bool is_word_aligned(const void* p) {
+    return ((uint32_t)p & 3) == 0;
+}
 
 size_t strlen(const char* str) {
-    size_t len = 0;
-    while (str[len])
-        len++;
-    return len;
+    const char* p = str;
+
+    while (!is_word_aligned(p)) {
+        if (!*p)
+            return p - str;
+        p++;
+    }
+
+    const string_word_t* w = (const string_word_t*)p;
+    while (!swar_has_zero(*w))
+        w++;
+
+    p = (const char*)w;
+    while (*p)
+        p++;
+    return p - str;
 }
 
 char* strcpy(char* dest, const char* src) {
@@ -23,6 +57,24 @@ char* strncpy(char* dest, const char* src, size_t n) {
 }
 
 int strcmp(const char* str1, const char* str2) {
+    // Equally aligned strings can be compared a dword at a time
+    if (((uint32_t)str1 & 3) == ((uint32_t)str2 & 3)) {
+        while (!is_word_aligned(str1) && *str1 && (*str1 == *str2)) {
+            str1++;
+            str2++;
+        }
+        if (is_word_aligned(str1)) {
+            const string_word_t* w1 = (const string_word_t*)str1;
+            const string_word_t* w2 = (const string_word_t*)str2;
+            while (*w1 == *w2 && !swar_has_zero(*w1)) {
+                w1++;
+                w2++;
+            }
+            str1 = (const char*)w1;
+            str2 = (const char*)w2;
+        }
+    }
+
     while (*str1 && (*str1 == *str2)) {
         str1++;
         str2++;
@@ -31,6 +83,25 @@ int strcmp(const char* str1, const char* str2) {
 }
 
 int strncmp(const char* str1, const char* str2, size_t n) {
+    if (((uint32_t)str1 & 3) == ((uint32_t)str2 & 3)) {
+        while (n && !is_word_aligned(str1) && *str1 && (*str1 == *str2)) {
+            ++str1;
+            ++str2;
+            --n;
+        }
+        if (is_word_aligned(str1)) {
+            const string_word_t* w1 = (const string_word_t*)str1;
+            const string_word_t* w2 = (const string_word_t*)str2;
+            while (n >= 4 && *w1 == *w2 && !swar_has_zero(*w1)) {
+                w1++;
+                w2++;
+                n -= 4;
+            }
+            str1 = (const char*)w1;
+            str2 = (const char*)w2;
+        }
+    }
+
     while (n && *str1 && (*str1 == *str2)) {
         ++str1;
         ++str2;
@@ -64,7 +135,24 @@ char* strncat(char* dest, const char* src, size_t n) {
 }
 
 char* strchr(const char* str, int c) {
-    while (*str != (char)c) {
+    char ch = (char)c;
+
+    while (!is_word_aligned(str)) {
+        if (*str == ch)
+            return (char*)str;
+        if (!*str)
+            return NULL;
+        str++;
+    }
+
+    // Stop at the first word holding either the character or the terminator
+    uint32_t pattern = (uint8_t)ch * SWAR_ONES;
+    const string_word_t* w = (const string_word_t*)str;
+    while (!swar_has_zero(*w) && !swar_has_zero(*w ^ pattern))
+        w++;
+
+    str = (const char*)w;
+    while (*str != ch) {
         if (!*str++) {
             return NULL;
         }
@@ -73,16 +161,17 @@ char* strchr(const char* str, int c) {
 }
 
 char* strrchr(const char* str, int c) {
-    char* last = NULL;
-    while (*str) {
-        if (*str == (char)c) {
-            last = (char*)str;
-        }
-        str++;
+    size_t len = strlen(str);
+    if ((char)c == '\0') {
+        return (char*)str + len;
     }
-    return last;
+    return memrchr(str, c, len);
 }
 
+// Boyer-Moore-Horspool. Each window is checked from its last byte, and a
+// mismatch shifts the window by that byte's distance from the end of the
+// needle. Shifts are stored in bytes and capped at 255, which only makes
+// long needles shift a little less than they could.
 char* strstr(const char* haystack, const char* needle) {
     if (!haystack || !needle) {
         return NULL;
@@ -91,14 +180,30 @@ char* strstr(const char* haystack, const char* needle) {
     if (*needle == '\0') {
         return (char*)haystack;
     }
+    if (needle[1] == '\0') {
+        return strchr(haystack, needle[0]);
+    }
     
     size_t needle_len = strlen(needle);
-    
-    while (*haystack) {
-        if (strncmp(haystack, needle, needle_len) == 0) {
-            return (char*)haystack;
+    size_t haystack_len = strlen(haystack);
+    if (needle_len > haystack_len) {
+        return NULL;
+    }
+
+    uint8_t skip[256];
+    size_t last = needle_len - 1;
+    memset(skip, last < 255 ? needle_len : 255, sizeof(skip));
+    for (size_t i = 0; i < last; i++) {
+        size_t distance = last - i;
+        skip[(uint8_t)needle[i]] = distance < 255 ? distance : 255;
+    }
+
+    const unsigned char* h = (const unsigned char*)haystack;
+    unsigned char tail = (unsigned char)needle[last];
+    for (size_t pos = 0; pos + needle_len <= haystack_len; pos += skip[h[pos + last]]) {
+        if (h[pos + last] == tail && memcmp(h + pos, needle, last) == 0) {
+            return (char*)haystack + pos;
         }
-        haystack++;
     }
     
     return NULL;
@@ -173,24 +278,237 @@ int atoi(const char* str) {
     return sign * result;
 }
 
+// Memory functions
+//
+// memcpy/memset pick a strategy from the CPU features found at boot:
+// "rep movsd/stosd" everywhere, "rep movsb/stosb" when the CPU has ERMS
+// (fast microcoded byte strings), and SSE2 non-temporal stores for blocks
+// large enough to flush the cache anyway. string_init() makes the choice;
+// until it runs the plain dword versions are used.
+
+#define STRING_SMALL_COPY   16          // Below this a simple loop beats rep setup
+#define STRING_STREAM_MIN   (256 * 1024) // Non-temporal stores from here up
+
+static bool string_erms = false;
+static bool string_sse2 = false;
+
+void string_init(void) {
+    string_erms = (cpu_get_features7_ebx() & CPU_FEATURE7_ERMS) != 0;
+    string_sse2 = cpu_sse_enabled();
+}
+
+static inline void rep_movsb(void* dest, const void* src, size_t n) {
+    asm volatile("rep movsb"
+                 : "+D"(dest), "+S"(src), "+c"(n)
+                 :
+                 : "memory");
+}
+
+static inline void rep_stosb(void* dest, uint8_t value, size_t n) {
+    asm volatile("rep stosb"
+                 : "+D"(dest), "+c"(n)
+                 : "a"(value)
+                 : "memory");
+}
+
+// Stream 64-byte blocks past the cache. d must be 16-byte aligned.
+static void stream_copy(uint8_t* d, const uint8_t* s, size_t blocks) {
+    asm volatile(
+        "1:\n\t"
+        "movdqu 0(%1), %%xmm0\n\t"
+        "movdqu 16(%1), %%xmm1\n\t"
+        "movdqu 32(%1), %%xmm2\n\t"
+        "movdqu 48(%1), %%xmm3\n\t"
+        "movntdq %%xmm0, 0(%0)\n\t"
+        "movntdq %%xmm1, 16(%0)\n\t"
+        "movntdq %%xmm2, 32(%0)\n\t"
+        "movntdq %%xmm3, 48(%0)\n\t"
+        "addl $64, %1\n\t"
+        "addl $64, %0\n\t"
+        "decl %2\n\t"
+        "jnz 1b\n\t"
+        "sfence"
+        : "+r"(d), "+r"(s), "+r"(blocks)
+        :
+        : "memory", "cc");
+}
+
+static void stream_fill(uint8_t* d, uint32_t pattern, size_t blocks) {
+    asm volatile(
+        "movd %2, %%xmm0\n\t"
+        "pshufd $0, %%xmm0, %%xmm0\n\t"
+        "1:\n\t"
+        "movntdq %%xmm0, 0(%0)\n\t"
+        "movntdq %%xmm0, 16(%0)\n\t"
+        "movntdq %%xmm0, 32(%0)\n\t"
+        "movntdq %%xmm0, 48(%0)\n\t"
+        "addl $64, %0\n\t"
+        "decl %1\n\t"
+        "jnz 1b\n\t"
+        "sfence"
+        : "+r"(d), "+r"(blocks)
+        : "r"(pattern)
+        : "memory", "cc");
+}
+
 void* memset(void* ptr, int value, size_t num) {
-    unsigned char* p = ptr;
-    while (num--)
-        *p++ = (unsigned char)value;
+    uint8_t* p = ptr;
+    uint8_t byte = (uint8_t)value;
+
+    if (num < STRING_SMALL_COPY) {
+        while (num--)
+            *p++ = byte;
+        return ptr;
+    }
+
+    uint32_t pattern = byte * 0x01010101u;
+
+    if (string_sse2 && num >= STRING_STREAM_MIN) {
+        size_t head = (16 - ((uint32_t)p & 15)) & 15;
+        rep_stosb(p, byte, head);
+        p += head;
+        num -= head;
+
+        stream_fill(p, pattern, num / 64);
+        p += num & ~(size_t)63;
+        num &= 63;
+        rep_stosb(p, byte, num);
+        return ptr;
+    }
+
+    if (string_erms) {
+        rep_stosb(p, byte, num);
+        return ptr;
+    }
+
+    size_t words = num / 4;
+    asm volatile("rep stosl"
+                 : "+D"(p), "+c"(words)
+                 : "a"(pattern)
+                 : "memory");
+    rep_stosb(p, byte, num & 3);
     return ptr;
 }
 
 void* memcpy(void* dest, const void* src, size_t n) {
-    char* d = dest;
-    const char* s = src;
-    while (n--)
-        *d++ = *s++;
+    uint8_t* d = dest;
+    const uint8_t* s = src;
+
+    if (n < STRING_SMALL_COPY) {
+        while (n--)
+            *d++ = *s++;
+        return dest;
+    }
+
+    if (string_sse2 && n >= STRING_STREAM_MIN) {
+        size_t head = (16 - ((uint32_t)d & 15)) & 15;
+        rep_movsb(d, s, head);
+        d += head;
+        s += head;
+        n -= head;
+
+        stream_copy(d, s, n / 64);
+        d += n & ~(size_t)63;
+        s += n & ~(size_t)63;
+        rep_movsb(d, s, n & 63);
+        return dest;
+    }
+
+    if (string_erms) {
+        rep_movsb(d, s, n);
+        return dest;
+    }
+
+    size_t words = n / 4;
+    asm volatile("rep movsl"
+                 : "+D"(d), "+S"(s), "+c"(words)
+                 :
+                 : "memory");
+    rep_movsb(d, s, n & 3);
+    return dest;
+}
+
+void* memmove(void* dest, const void* src, size_t n) {
+    uint8_t* d = dest;
+    const uint8_t* s = src;
+
+    // Forward copies are safe unless dest starts inside src
+    if (d <= s || d >= s + n) {
+        return memcpy(dest, src, n);
+    }
+
+    // Copy backwards from the last byte
+    d += n - 1;
+    s += n - 1;
+    asm volatile("std\n\t"
+                 "rep movsb\n\t"
+                 "cld"
+                 : "+D"(d), "+S"(s), "+c"(n)
+                 :
+                 : "memory");
     return dest;
 }
 
+void* memchr(const void* ptr, int value, size_t num) {
+    const unsigned char* p = ptr;
+    unsigned char ch = (unsigned char)value;
+
+    while (num && !is_word_aligned(p)) {
+        if (*p == ch)
+            return (void*)p;
+        p++;
+        num--;
+    }
+
+    uint32_t pattern = ch * SWAR_ONES;
+    while (num >= 4 && !swar_has_zero(*(const string_word_t*)p ^ pattern)) {
+        p += 4;
+        num -= 4;
+    }
+
+    while (num--) {
+        if (*p == ch)
+            return (void*)p;
+        p++;
+    }
+    return NULL;
+}
+
+void* memrchr(const void* ptr, int value, size_t num) {
+    const unsigned char* p = (const unsigned char*)ptr + num;
+    unsigned char ch = (unsigned char)value;
+
+    // p is one past the byte under test
+    while (num && !is_word_aligned(p)) {
+        if (*--p == ch)
+            return (void*)p;
+        num--;
+    }
+
+    uint32_t pattern = ch * SWAR_ONES;
+    while (num >= 4 && !swar_has_zero(*(const string_word_t*)(p - 4) ^ pattern)) {
+        p -= 4;
+        num -= 4;
+    }
+
+    while (num--) {
+        if (*--p == ch)
+            return (void*)p;
+    }
+    return NULL;
+}
+
 int memcmp(const void* ptr1, const void* ptr2, size_t num) {
     const unsigned char* p1 = ptr1;
     const unsigned char* p2 = ptr2;
+
+    // Skip equal words, then find the differing byte
+    while (num >= 4 && *(const string_word_t*)p1 == *(const string_word_t*)p2) {
+        p1 += 4;
+        p2 += 4;
+        num -= 4;
+    }
+
     while (num--) {
         if (*p1 != *p2)
             return *p1 - *p2;
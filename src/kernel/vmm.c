@@ -0,0 +1,260 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../include/vmm.h"
+#include "../include/pmm.h"
+#include "../include/cpu.h"
+#include "../include/string.h"
+
+extern void terminal_writestring(const char* data);
+
+// End of the kernel image from linker.ld
+extern uint8_t _kernel_end[];
+
+// Virtual memory manager
+//
+// One address space for the whole kernel. The image (0 up to _kernel_end,
+// which includes VGA memory and the boot structures in low memory) is covered
+// by identity 4MB pages so it costs a handful of TLB entries. Frames handed
+// out later by the PMM are identity mapped with 4KB pages by whoever
+// allocates them (heap, slab, DMA), which is what "on demand" means until
+// there is an IDT to take page faults.
+//
+// The last directory entry points back at the directory itself, so the page
+// table for directory slot i is always visible at VMM_RECURSIVE_BASE + i * 4K.
+
+#define VMM_RECURSIVE_SLOT 1023
+#define VMM_FRAME_MASK     0xFFFFF000
+#define VMM_LARGE_MASK     0xFFC00000
+
+#define CR0_WP             (1 << 16)
+#define CR0_PG             (1u << 31)
+#define CR4_PSE            (1 << 4)
+#define CR4_PGE            (1 << 7)
+
+static uint32_t vmm_directory[1024] __attribute__((aligned(4096)));
+static bool paging_enabled = false;
+static bool large_pages = false;
+static bool global_pages = false;
+
+static inline void vmm_invlpg(uint32_t addr) {
+    asm volatile("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+// Page table behind directory slot pdi, creating it if asked to
+static uint32_t* vmm_get_table(uint32_t pdi, bool create) {
+    uint32_t pde = vmm_directory[pdi];
+
+    if (pde & VMM_PAGE_PRESENT) {
+        if (pde & VMM_PAGE_LARGE) {
+            return NULL;
+        }
+        if (paging_enabled) {
+            return (uint32_t*)(VMM_RECURSIVE_BASE + pdi * VMM_PAGE_SIZE);
+        }
+        return (uint32_t*)(pde & VMM_FRAME_MASK);
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    uint32_t frame = pmm_alloc_frame();
+    if (!frame) {
+        return NULL;
+    }
+
+    vmm_directory[pdi] = frame | VMM_PAGE_PRESENT | VMM_PAGE_WRITE;
+
+    uint32_t* table = (uint32_t*)frame;
+    if (paging_enabled) {
+        table = (uint32_t*)(VMM_RECURSIVE_BASE + pdi * VMM_PAGE_SIZE);
+        vmm_invlpg((uint32_t)table);
+    }
+    memset(table, 0, VMM_PAGE_SIZE);
+
+    return table;
+}
+
+bool vmm_map(uint32_t virt, uint32_t phys, uint32_t count, uint32_t flags) {
+    virt &= VMM_FRAME_MASK;
+    phys &= VMM_FRAME_MASK;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t page = virt + i * VMM_PAGE_SIZE;
+        uint32_t frame = phys + i * VMM_PAGE_SIZE;
+        uint32_t pdi = page >> 22;
+        uint32_t pde = vmm_directory[pdi];
+
+        if (pdi == VMM_RECURSIVE_SLOT) {
+            vmm_unmap(virt, i);
+            return false;
+        }
+
+        // Already covered by a large page
+        if ((pde & VMM_PAGE_PRESENT) && (pde & VMM_PAGE_LARGE)) {
+            if ((pde & VMM_LARGE_MASK) + (page & ~VMM_LARGE_MASK) == frame) {
+                continue;
+            }
+            vmm_unmap(virt, i);
+            return false;
+        }
+
+        uint32_t* table = vmm_get_table(pdi, true);
+        if (!table) {
+            vmm_unmap(virt, i);
+            return false;
+        }
+
+        table[(page >> 12) & 0x3FF] = frame | (flags & 0xFFF & ~VMM_PAGE_LARGE) | VMM_PAGE_PRESENT;
+        if (paging_enabled) {
+            vmm_invlpg(page);
+        }
+    }
+
+    return true;
+}
+
+void vmm_unmap(uint32_t virt, uint32_t count) {
+    virt &= VMM_FRAME_MASK;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t page = virt + i * VMM_PAGE_SIZE;
+        uint32_t* table = vmm_get_table(page >> 22, false);
+        if (!table) {
+            continue; // Unmapped, or part of a large page that stays mapped
+        }
+
+        table[(page >> 12) & 0x3FF] = 0;
+        if (paging_enabled) {
+            vmm_invlpg(page);
+        }
+    }
+}
+
+uint32_t vmm_get_physical(uint32_t virt) {
+    if (!paging_enabled) {
+        return virt;
+    }
+
+    uint32_t pde = vmm_directory[virt >> 22];
+    if (!(pde & VMM_PAGE_PRESENT)) {
+        return 0;
+    }
+    if (pde & VMM_PAGE_LARGE) {
+        return (pde & VMM_LARGE_MASK) + (virt & ~VMM_LARGE_MASK);
+    }
+
+    uint32_t* table = (uint32_t*)(VMM_RECURSIVE_BASE + (virt >> 22) * VMM_PAGE_SIZE);
+    uint32_t pte = table[(virt >> 12) & 0x3FF];
+    if (!(pte & VMM_PAGE_PRESENT)) {
+        return 0;
+    }
+    return (pte & VMM_FRAME_MASK) + (virt & ~VMM_FRAME_MASK);
+}
+
+// Identity map an arbitrary byte range
+static void vmm_identity_map(uint32_t base, uint32_t length) {
+    if (length == 0) {
+        return;
+    }
+    uint32_t first = base & VMM_FRAME_MASK;
+    uint32_t last = (base + length + VMM_PAGE_SIZE - 1) & VMM_FRAME_MASK;
+    vmm_map(first, first, (last - first) / VMM_PAGE_SIZE, VMM_PAGE_WRITE);
+}
+
+void vmm_init(const multiboot_info_t* mbi) {
+    if (!pmm_is_initialized()) {
+        terminal_writestring("VMM: No physical allocator, paging left disabled\n");
+        return;
+    }
+
+    uint32_t features = cpu_get_features_edx();
+    large_pages = (features & CPU_FEATURE_PSE) != 0;
+    global_pages = (features & CPU_FEATURE_PGE) != 0;
+
+    memset(vmm_directory, 0, sizeof(vmm_directory));
+
+    // Frames under the recursive slot could never be identity mapped
+    pmm_reserve_region(VMM_RECURSIVE_BASE, VMM_LARGE_PAGE_SIZE);
+
+    // Kernel image and everything below it
+    uint32_t kernel_end = (uint32_t)_kernel_end;
+    uint32_t global = global_pages ? VMM_PAGE_GLOBAL : 0;
+    uint32_t large_count = 0;
+
+    if (large_pages) {
+        large_count = (kernel_end + VMM_LARGE_PAGE_SIZE - 1) / VMM_LARGE_PAGE_SIZE;
+        for (uint32_t i = 0; i < large_count; i++) {
+            vmm_directory[i] = (i * VMM_LARGE_PAGE_SIZE) | VMM_PAGE_PRESENT | VMM_PAGE_WRITE |
+                               VMM_PAGE_LARGE | global;
+        }
+    } else {
+        uint32_t pages = (kernel_end + VMM_PAGE_SIZE - 1) / VMM_PAGE_SIZE;
+        if (!vmm_map(0, 0, pages, VMM_PAGE_WRITE | global)) {
+            terminal_writestring("VMM: Out of memory for kernel page tables, paging left disabled\n");
+            return;
+        }
+    }
+
+    // The frame bitmap sits just above the kernel
+    uint32_t bitmap_base, bitmap_size;
+    pmm_get_bitmap_region(&bitmap_base, &bitmap_size);
+    vmm_identity_map(bitmap_base, bitmap_size);
+
+    // Boot information is read long after boot
+    if (mbi) {
+        vmm_identity_map((uint32_t)mbi, sizeof(multiboot_info_t));
+        if (mbi->flags & MULTIBOOT_FLAG_MMAP) {
+            vmm_identity_map(mbi->mmap_addr, mbi->mmap_length);
+        }
+        if ((mbi->flags & MULTIBOOT_FLAG_CMDLINE) && mbi->cmdline) {
+            vmm_identity_map(mbi->cmdline, strlen((const char*)mbi->cmdline) + 1);
+        }
+        if ((mbi->flags & MULTIBOOT_FLAG_LOADER) && mbi->boot_loader_name) {
+            vmm_identity_map(mbi->boot_loader_name, strlen((const char*)mbi->boot_loader_name) + 1);
+        }
+    }
+
+    vmm_directory[VMM_RECURSIVE_SLOT] = (uint32_t)vmm_directory | VMM_PAGE_PRESENT | VMM_PAGE_WRITE;
+
+    // Turn it on
+    if (large_pages || global_pages) {
+        uint32_t cr4;
+        asm volatile("mov %%cr4, %0" : "=r"(cr4));
+        if (large_pages) {
+            cr4 |= CR4_PSE;
+        }
+        if (global_pages) {
+            cr4 |= CR4_PGE;
+        }
+        asm volatile("mov %0, %%cr4" : : "r"(cr4));
+    }
+
+    asm volatile("mov %0, %%cr3" : : "r"((uint32_t)vmm_directory) : "memory");
+
+    uint32_t cr0;
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    cr0 |= CR0_PG | CR0_WP;
+    asm volatile("mov %0, %%cr0" : : "r"(cr0) : "memory");
+
+    paging_enabled = true;
+
+    char buffer[16];
+    terminal_writestring("VMM: Paging enabled, kernel mapped with ");
+    if (large_pages) {
+        itoa(large_count, buffer, 10);
+        terminal_writestring(buffer);
+        terminal_writestring(" 4MB pages\n");
+    } else {
+        terminal_writestring("4KB pages (no PSE)\n");
+    }
+}
+
+bool vmm_is_enabled(void) {
+    return paging_enabled;
+}
+
+bool vmm_has_large_pages(void) {
+    return large_pages;
+}